@@ -3,27 +3,45 @@
 TaskHandle_t handl_mpu_sampling_begin;
 TaskHandle_t handl_fft_calculation;
 TaskHandle_t handl_uart_fft_components;
-// TaskHandle_t handl_uart_data_samples;
+TaskHandle_t handl_fft_benchmark = NULL;
+TaskHandle_t handl_uart_data_samples;
+TaskHandle_t handl_uart_goertzel;
 
-SemaphoreHandle_t semphr_sampling_request_a;
-SemaphoreHandle_t semphr_sampling_request_b;
 SemaphoreHandle_t semphr_uart_request;
+SemaphoreHandle_t semphr_fft_sent;
 
 QueueHandle_t queue_uart_event_queue;
 QueueHandle_t queue_enqueued_msg_processing;
 QueueHandle_t queue_fft_calculation;
+QueueHandle_t queue_capture_start;
+QueueHandle_t queue_goertzel_results;
+QueueHandle_t queue_sampling_events;
+static QueueSetHandle_t queue_set_msg_handler; // received commands and sampling events
+static uint32_t sampling_events_dropped = 0;
 
-bool data_ready_a = false;
-bool data_ready_b = false;
-bool fft_ready_a = false;
-bool fft_ready_b = false;
-bool sampling_a = false;
-bool sampling_b = false;
+bool streaming = false;
+bool goertzel_running = false;
 
-float *data_samples_a;
-float *data_samples_b;
+captureBufferType capture_pool[CAPTURE_POOL_SIZE];
+uint32_t capture_n_samples = N_SAMPLES; // samples per channel of the next capture, "N <value>"
+streamRingType stream_ring;
+goertzelBankType goertzel_bank;
+int16_t *stream_window_arr;
 indexed_float_type *indexed_magnitudes;
+float *fft_power_arr;
 float *fft_complex_arr;
+fftResultInfoType fft_result_info = {.sample_rate_hz = MPU_SAMPLING_RATE_HZ};
+fftPeakListType fft_peak_list;
+volatile int fft_spectrum_capture = -1; // capture id of the single channel capture spectrum in the FFT buffers, -1 none
+static volatile uint32_t fft_settings_generation = 0; // incremented by every FFT setting command (message handler only)
+static volatile uint32_t fft_spectrum_generation = 0; // fft_settings_generation the spectrum in the FFT buffers was calculated with
+static capture_state_type capture_dump_return_state[CAPTURE_POOL_SIZE]; // state of a capture before its dump, set before the dump is requested
+static int sampling_capture = -1; // capture id recorded by the sampling task, -1 none (sampling task only)
+
+#if CAPTURE_POOL_SIZE < 2 || CAPTURE_POOL_SIZE > 16
+#error "CAPTURE_POOL_SIZE must be 2..16 (A/B aliases, dump request bits)"
+#endif
+uartRxParserType uart_rx_parser;
 
 void task_initialization(void *params)
 {
@@ -39,11 +57,20 @@ void task_initialization(void *params)
 	// 	vTaskDelete(NULL);
 	// }
 
-	data_samples_a = (float *)heap_caps_malloc(N_SAMPLES * sizeof(float), MALLOC_CAP_SPIRAM);
-	data_samples_b = (float *)heap_caps_malloc(N_SAMPLES * sizeof(float), MALLOC_CAP_SPIRAM);
-	if (data_samples_a == NULL || data_samples_b == NULL)
+	for (int capture_id = 0; capture_id < CAPTURE_POOL_SIZE; capture_id++)
 	{
-		ESP_LOGE(TAG, "Failed to allocate memory for data_sampled");
+		if (capture_buffer_init(&capture_pool[capture_id]) != 0)
+		{
+			ESP_LOGE(TAG, "Failed to allocate memory for data_sampled");
+			vTaskDelete(NULL);
+		}
+	}
+
+	// Streaming mode ring buffer and the contiguous copy of one window
+	stream_window_arr = (int16_t *)heap_caps_malloc(STREAM_WINDOW_SIZE * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+	if (stream_ring_init(&stream_ring, STREAM_RING_SIZE) != 0 || stream_window_arr == NULL)
+	{
+		ESP_LOGE(TAG, "Failed to allocate memory for stream ring");
 		vTaskDelete(NULL);
 	}
 
@@ -55,8 +82,16 @@ void task_initialization(void *params)
 		vTaskDelete(NULL);
 	}
 
+	// Power spectrum of the fc32 path, ranked before only the selected bins become magnitudes
+	fft_power_arr = (float *)heap_caps_malloc(MAGNITUDES_SIZE * sizeof(float), MALLOC_CAP_SPIRAM);
+	if (!fft_power_arr)
+	{
+		ESP_LOGE(TAG, "Failed to allocate memory for fft_power_arr");
+		vTaskDelete(NULL);
+	}
+
 	// Allocate aligned memory for fft_complex_arr in PSRAM with 16-byte alignment
-	fft_complex_arr = (float *)heap_caps_aligned_alloc(16, N_SAMPLES * 2 * sizeof(float), MALLOC_CAP_SPIRAM);
+	fft_complex_arr = (float *)heap_caps_aligned_alloc(16, FFT_COMPONENTS_SIZE * sizeof(float), MALLOC_CAP_SPIRAM);
 	// fft_complex_arr = (float*)heap_caps_aligned_alloc(16, N_SAMPLES * 2 * sizeof(float), MALLOC_CAP_SPIRAM);
 	if (!fft_complex_arr)
 	{
@@ -75,25 +110,42 @@ void task_initialization(void *params)
 		ESP_LOGE(TAG, "Failed to init i2c with error code %d", error_code);
 		vTaskDelete(NULL);
 	}
+	// Serialize the framed UART output of all tasks
+	if ((error_code = uart_frame_init(UART_NUM)) != 0)
+	{
+		ESP_LOGE(TAG, "Failed to init uart frames with error code %d", error_code);
+		vTaskDelete(NULL);
+	}
 	// Init FFT memory
 	if ((error_code = fft_init()) != 0)
 	{
 		ESP_LOGE(TAG, "Failed to init fft with error code %d", error_code);
 		vTaskDelete(NULL);
 	}
+	// Init hardware timer that paces the data sampling
+	if ((error_code = sampling_timer_init(SAMPLING_TIMER_RATE_HZ)) != 0)
+	{
+		ESP_LOGE(TAG, "Failed to init sampling timer with error code %d", error_code);
+		vTaskDelete(NULL);
+	}
 
 	// Create semaphore binaries
-	semphr_sampling_request_a = xSemaphoreCreateBinary();
-	semphr_sampling_request_b = xSemaphoreCreateBinary();
 	semphr_uart_request = xSemaphoreCreateBinary();
+	semphr_fft_sent = xSemaphoreCreateBinary();
 
 	// Create queues
-	queue_enqueued_msg_processing = xQueueCreate(4, sizeof(TaskQueueMessage_type));
-	queue_fft_calculation = xQueueCreate(2, sizeof(FFTQueueMessage_type));
-
-	// Enable data requests
-	xSemaphoreGive(semphr_sampling_request_a);
-	xSemaphoreGive(semphr_sampling_request_b);
+	queue_enqueued_msg_processing = xQueueCreate(MSG_QUEUE_LEN, sizeof(TaskQueueMessage_type));
+	queue_sampling_events = xQueueCreate(SAMPLING_EVENT_QUEUE_LEN, sizeof(SamplingEvent_type));
+	queue_set_msg_handler = xQueueCreateSet(MSG_QUEUE_LEN + SAMPLING_EVENT_QUEUE_LEN);
+	if (queue_set_msg_handler == NULL || xQueueAddToSet(queue_enqueued_msg_processing, queue_set_msg_handler) != pdPASS ||
+		xQueueAddToSet(queue_sampling_events, queue_set_msg_handler) != pdPASS)
+	{
+		ESP_LOGE(TAG, "Failed to create message handler queue set");
+		vTaskDelete(NULL);
+	}
+	queue_fft_calculation = xQueueCreate(CAPTURE_POOL_SIZE + 2, sizeof(FFTQueueMessage_type)); // every capture and stream windows
+	queue_capture_start = xQueueCreate(CAPTURE_POOL_SIZE, sizeof(uint8_t));
+	queue_goertzel_results = xQueueCreate(GOERTZEL_QUEUE_LEN, sizeof(goertzelResultType));
 
 	// Create FFT tasks
 	if (xTaskCreatePinnedToCore(task_mpu6050_data_sampling, "MPU Data sampling task", TASK_MPU_SAMPLING_STACK_SIZE, NULL, 15, &handl_mpu_sampling_begin, APP_CPU_NUM) != pdPASS)
@@ -101,7 +153,12 @@ void task_initialization(void *params)
 		ESP_LOGE(TAG, "Failed to create mpu data sampling task");
 		vTaskDelete(NULL);
 	}
+#if FFT_DUAL_CORE == 1
+	// The FFT task runs one half of every transform on core 0, away from the sampling task, the FFT worker the other half on core 1
+	if (xTaskCreatePinnedToCore(task_fft_calculation, "FFT calculation task", TASK_FFT_CALC_STACK_SIZE, NULL, 10, &handl_fft_calculation, PRO_CPU_NUM) != pdPASS)
+#else
 	if (xTaskCreate(task_fft_calculation, "FFT calculation task", TASK_FFT_CALC_STACK_SIZE, NULL, 10, &handl_fft_calculation) != pdPASS)
+#endif
 	{
 		ESP_LOGE(TAG, "Failed to create fft calculation task");
 		vTaskDelete(NULL);
@@ -111,11 +168,17 @@ void task_initialization(void *params)
 		ESP_LOGE(TAG, "Failed to create fft components uart transmission task");
 		vTaskDelete(NULL);
 	}
-	// if (xTaskCreate(task_uart_data_samples, "Send data samples task", TASK_SEND_DATA_SAMPLES_STACK_SIZE, NULL, 10, &handl_uart_data_samples) != pdPASS)
-	// {
-	// 	ESP_LOGE(TAG, "Failed to create fft components uart transmission task");
-	// 	vTaskDelete(NULL);
-	// }
+	// Lower priority than sampling and FFT, a raw dump runs alongside the next capture
+	if (xTaskCreate(task_uart_data_samples, "Send data samples task", TASK_SEND_DATA_SAMPLES_STACK_SIZE, NULL, 5, &handl_uart_data_samples) != pdPASS)
+	{
+		ESP_LOGE(TAG, "Failed to create data samples uart transmission task");
+		vTaskDelete(NULL);
+	}
+	if (xTaskCreate(task_uart_goertzel, "Send Goertzel task", TASK_SEND_GOERTZEL_STACK_SIZE, NULL, 5, &handl_uart_goertzel) != pdPASS)
+	{
+		ESP_LOGE(TAG, "Failed to create goertzel uart transmission task");
+		vTaskDelete(NULL);
+	}
 
 	// Init UART with ISR queue
 	if ((error_code = myuart_init_with_isr_queue(&uart_config, UART_NUM, UART_TXD, UART_RXD, UART_TX_BUFF_SIZE, UART_RX_BUFF_SIZE, &queue_uart_event_queue, UART_EVENT_QUEUE_SIZE, 0)) != 0)
@@ -134,17 +197,6 @@ void task_initialization(void *params)
 		ESP_LOGE(TAG, "Failed to create receive queue msg task");
 		vTaskDelete(NULL);
 	}
-	// Enable pattern detection and reset the pattern queue
-	if ((error_code = uart_enable_pattern_det_baud_intr(UART_NUM, '+', UART_PATTERN_SIZE, 8, 0, 0)) != 0)
-	{
-		ESP_LOGE(TAG, "Failed to enable pattern detection baud interrupt");
-		vTaskDelete(NULL);
-	}
-	if ((error_code = uart_pattern_queue_reset(UART_NUM, UART_PAT_QUEUE_SIZE)) != 0)
-	{
-		ESP_LOGE(TAG, "Failed to reset uart pattern queue");
-		vTaskDelete(NULL);
-	}
 
 	if (DEBUG_STACKS == 1)
 	{
@@ -156,104 +208,404 @@ void task_initialization(void *params)
 	vTaskDelete(NULL);
 }
 
+/**
+ * @brief Check if the sampling task writes a capture buffer
+ *
+ * @param capture capture buffer
+ * @return true if the buffer is SAMPLING
+ */
+static inline bool capture_sampling(captureBufferType *capture)
+{
+	return capture_state_get(&capture->state) == CAPTURE_STATE_SAMPLING;
+}
+
+/**
+ * @brief Check if a capture is being recorded or waiting to be recorded
+ *
+ * @return true if a capture buffer is SAMPLING or QUEUED
+ */
+static bool capture_pool_recording(void)
+{
+	for (int capture_id = 0; capture_id < CAPTURE_POOL_SIZE; capture_id++)
+	{
+		capture_state_type state = capture_state_get(&capture_pool[capture_id].state);
+		if (state == CAPTURE_STATE_SAMPLING || state == CAPTURE_STATE_QUEUED)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * @brief Check if the sampling task has anything to record
+ *
+ * @return true if a capture is recorded or queued, the stream or the Goertzel bank is running
+ */
+static inline bool sampling_active(void)
+{
+	return capture_pool_recording() || streaming || goertzel_running;
+}
+
+/**
+ * @brief Start recording the next queued capture
+ *
+ * Captures are recorded one after another in START order, the next one begins with the sample after the previous one.
+ *
+ * @return capture id now SAMPLING, -1 if no capture is queued
+ */
+static int sampling_next_capture(void)
+{
+	uint8_t capture_id;
+
+	while (xQueueReceive(queue_capture_start, &capture_id, 0) == pdTRUE)
+	{
+		if (capture_state_transition(&capture_pool[capture_id].state, CAPTURE_STATE_QUEUED, CAPTURE_STATE_SAMPLING))
+			return capture_id;
+	}
+	return -1;
+}
+
+/**
+ * @brief Stop all recordings after a sampling error, incomplete and queued captures are released as FREE
+ */
+static void sampling_stop_all(void)
+{
+	xQueueReset(queue_capture_start);
+	for (int capture_id = 0; capture_id < CAPTURE_POOL_SIZE; capture_id++)
+	{
+		capture_state_transition(&capture_pool[capture_id].state, CAPTURE_STATE_SAMPLING, CAPTURE_STATE_FREE);
+		capture_state_transition(&capture_pool[capture_id].state, CAPTURE_STATE_QUEUED, CAPTURE_STATE_FREE);
+	}
+	streaming = false;
+	goertzel_running = false;
+}
+
+/**
+ * @brief Union of the channel masks of the capture that is sampling, the stream and the Goertzel bank
+ *
+ * @return CAPTURE_CH_* mask of the channels that have to be read
+ */
+static inline uint8_t sampling_channel_mask(void)
+{
+	// The next queued capture may start within the read, so its channels are read as well
+	uint8_t capture_mask = (sampling_capture >= 0) ? capture_pool[sampling_capture].channel_mask : 0;
+	uint8_t next_id;
+	if (xQueuePeek(queue_capture_start, &next_id, 0) == pdTRUE)
+		capture_mask |= capture_pool[next_id].channel_mask;
+
+	return capture_mask | (streaming ? (1 << stream_ring.channel) : 0) | (goertzel_running ? (1 << goertzel_bank.channel) : 0);
+}
+
+/**
+ * @brief Hand a status over to the message handler without waiting, dropped if its queue is full
+ *
+ * @param type sampling_event_type
+ * @param capture_id capture the event belongs to, -1 none
+ */
+static void sampling_post_event(sampling_event_type type, int capture_id)
+{
+	SamplingEvent_type event = {.type = type, .capture_id = (int8_t)capture_id};
+	if (xQueueSend(queue_sampling_events, &event, 0) != pdTRUE)
+		sampling_events_dropped++;
+}
+
+#if MPU_SAMPLING_FIFO == 1
+/**
+ * @brief Restart the recordings after the FIFO overflowed and samples were lost
+ *
+ * The capture that is sampling starts again from its first sample, so it never joins samples from before
+ * and after the gap, and the Goertzel block in progress is dropped. The host is told which capture restarted
+ * ("A OVF", "FIFO OVF" if no capture is sampling).
+ *
+ * @param index next index in the capture that is sampling, reset to 0
+ */
+static void sampling_restart_after_gap(size_t *index)
+{
+	*index = 0;
+	if (goertzel_running)
+		goertzel_bank_reset(&goertzel_bank);
+	sampling_post_event(SAMPLING_EVENT_OVERFLOW, sampling_capture);
+}
+#endif
+
+/**
+ * @brief Store the raw sample in mpu_data_t into the capture that is sampling
+ *
+ * Raw counts are stored as read, bias and scale are applied when the FFT input is prepared.
+ * When a buffer is full, it is handed over as READY, a DATRDY event is posted and the next queued capture starts.
+ * In streaming mode every completed window is queued for the FFT task.
+ * The Goertzel bank is updated with every sample, completed blocks are queued for task_uart_goertzel.
+ *
+ * @param index next index in the capture that is sampling
+ */
+static void sampling_store_sample(size_t *index)
+{
+	FFTQueueMessage_type stream_msg = {.stream_window = true};
+
+	if (streaming && stream_ring_push(&stream_ring, mpu_data_t.accel_gyro_raw[stream_ring.channel], &stream_msg.window_start))
+	{
+		if (xQueueSend(queue_fft_calculation, &stream_msg, 0) != pdTRUE)
+			stream_ring.windows_dropped++;
+	}
+
+	static goertzelResultType goertzel_result; // Kept off the sampling task stack
+	if (goertzel_running && goertzel_bank_push(&goertzel_bank, mpu_data_t.accel_gyro_raw[goertzel_bank.channel], &goertzel_result))
+	{
+		if (xQueueSend(queue_goertzel_results, &goertzel_result, 0) != pdTRUE)
+			goertzel_bank.blocks_dropped++;
+	}
+
+	// A capture that stopped sampling (error) is dropped, the next queued one starts from the beginning
+	if (sampling_capture >= 0 && !capture_sampling(&capture_pool[sampling_capture]))
+		sampling_capture = -1;
+	if (sampling_capture < 0)
+	{
+		*index = 0;
+		if ((sampling_capture = sampling_next_capture()) < 0)
+			return;
+	}
+
+	// copy value to the data_samples arrays
+	captureBufferType *capture = &capture_pool[sampling_capture];
+	capture_buffer_store_sample(capture, *index, &mpu_data_t);
+	(*index)++;
+
+	// Hand the full buffer over, SEND / DUMP / START may claim it from READY
+	if (*index == capture->n_samples)
+	{
+		capture_state_transition(&capture->state, CAPTURE_STATE_SAMPLING, CAPTURE_STATE_READY);
+		sampling_post_event(SAMPLING_EVENT_DATRDY, sampling_capture);
+		*index = 0;
+		sampling_capture = sampling_next_capture();
+	}
+}
+
 void task_mpu6050_data_sampling(void *params)
 {
 	const char *TAG = "TSK DATA SAMPL";
-	const char *MSG_A_RDY = "A DATRDY";	 // Data samples A ready
-	const char *MSG_B_RDY = "B DATRDY";	 // Data samples B ready
-	const char *MPU_ERR_MSG = "MPU ERR"; // MPU reading data error
 	// UBaseType_t old_free_heap = 0;
 
-	size_t index_a = 0;
-	size_t index_b = 0;
-	TickType_t last_wake_time;
+	size_t index = 0;
+#if MPU_SAMPLING_FIFO == 1
+	static uint8_t fifo_frames[MPU_FIFO_MAX_BYTES]; // Burst read buffer, too large for the task stack
+	mpuFifoStreamType fifo_stream;
+	int n_frames = 0;
+#endif
 	while (1)
 	{
 		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-		last_wake_time = xTaskGetTickCount();
-		while (sampling_a || sampling_b)
+#if MPU_SAMPLING_FIFO == 1
+		if (mpu_fifo_stream_start(&i2c_buffer_t, &fifo_stream, MPU_FIFO_SAMPLING_EN_MASK) != 0)
+		{
+			ESP_LOGE(TAG, "Failed to start FIFO stream.");
+			sampling_post_event(SAMPLING_EVENT_MPU_ERROR, -1);
+			sampling_stop_all();
+			continue;
+		}
+#endif
+		if (sampling_timer_start() != 0)
+		{
+			ESP_LOGE(TAG, "Failed to start sampling timer.");
+			sampling_post_event(SAMPLING_EVENT_MPU_ERROR, -1);
+			sampling_stop_all();
+			continue;
+		}
+		while (sampling_active())
 		{
-			if (!mpu_data_read_extract_accel(&i2c_buffer_t, &mpu_data_t))
+			// Wait for the sampling timer tick, the period does not depend on the I2C read time
+			if (!sampling_timer_wait_tick(pdMS_TO_TICKS(SAMPLING_TIMER_TIMEOUT_MS)))
 			{
-				ESP_LOGE(TAG, "Error reading MPU6050 data.");
-				uart_write_bytes(UART_NUM, MPU_ERR_MSG, strlen(MPU_ERR_MSG));
-				sampling_a = false;
-				sampling_b = false;
+				ESP_LOGE(TAG, "Sampling timer tick timeout.");
+				sampling_post_event(SAMPLING_EVENT_MPU_ERROR, -1);
+				sampling_stop_all();
 				continue;
 			}
-			mpu_data_substract_err(&mpu_data_t, true);
-			mpu_data_to_fs(&mpu_data_t, true);
-
-			// copy value to the data_samples arrays
-			if (sampling_a)
+#if MPU_SAMPLING_FIFO == 1
+			// Drain all complete frames the MPU sampled since the last tick
+			n_frames = mpu_fifo_stream_read(&i2c_buffer_t, &fifo_stream, fifo_frames, sizeof(fifo_frames) / fifo_stream.frame_size);
+			if (n_frames == -2)
 			{
-				// Update array A
-				if (index_a < N_SAMPLES)
-				{
-					memcpy(&data_samples_a[index_a], &mpu_data_t.accel_gyro_g[0], sizeof(float)); // X-axis
-					index_a++;
-				}
-				// Raise data A ready flag and stop updating A
-				else
-				{
-					uart_write_bytes(UART_NUM, MSG_A_RDY, strlen(MSG_A_RDY));
-					index_a = 0;
-					sampling_a = false;
-					fft_ready_a = false;
-					data_ready_a = true;
-					xSemaphoreGive(semphr_sampling_request_a);
-					xSemaphoreGive(semphr_uart_request);
-				}
+				ESP_LOGW(TAG, "FIFO overflow, samples lost.");
+				sampling_restart_after_gap(&index);
+				continue;
 			}
-			if (sampling_b)
+			if (n_frames < 0)
 			{
-				// Update array B
-				if (index_b < N_SAMPLES)
-				{
-					memcpy(&data_samples_b[index_b], &mpu_data_t.accel_gyro_g[0], sizeof(float)); // X-axis
-					index_b++;
-				}
-				// Raise data B ready flag and stop updating B
-				else
-				{
-					uart_write_bytes(UART_NUM, MSG_B_RDY, strlen(MSG_B_RDY));
-					index_b = 0;
-					sampling_b = false;
-					fft_ready_b = false;
-					data_ready_b = true;
-					xSemaphoreGive(semphr_sampling_request_b);
-				}
+				ESP_LOGE(TAG, "Error reading MPU6050 FIFO.");
+				sampling_post_event(SAMPLING_EVENT_MPU_ERROR, -1);
+				sampling_stop_all();
+				continue;
+			}
+			for (int frame = 0; frame < n_frames && sampling_active(); frame++)
+			{
+				mpu_fifo_stream_extract_frame(&fifo_stream, &fifo_frames[frame * fifo_stream.frame_size], &mpu_data_t);
+				sampling_store_sample(&index);
+			}
+#else
+			// Gyro registers are read only if a sampling buffer records gyro channels
+			bool accel_only = (sampling_channel_mask() & CAPTURE_CH_GYRO_MASK) == 0;
+			if (!(accel_only ? mpu_data_read_extract_accel(&i2c_buffer_t, &mpu_data_t) : mpu_data_read_extract(&i2c_buffer_t, &mpu_data_t)))
+			{
+				ESP_LOGE(TAG, "Error reading MPU6050 data.");
+				sampling_post_event(SAMPLING_EVENT_MPU_ERROR, -1);
+				sampling_stop_all();
+				continue;
 			}
-			// Wait until 1 ms has passed (1 ms sampling frequency)
-			vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(1));
-			last_wake_time = xTaskGetTickCount();
+			sampling_store_sample(&index);
+#endif
+		}
+		sampling_timer_stop();
+		if (sampling_timer_get_overruns() > 0)
+		{
+			ESP_LOGW(TAG, "Missed %lu sampling ticks", sampling_timer_get_overruns());
+		}
+		if (sampling_events_dropped > 0)
+		{
+			ESP_LOGW(TAG, "Dropped %lu status events", sampling_events_dropped);
+		}
+#if MPU_SAMPLING_FIFO == 1
+		mpu_fifo_stream_stop(&i2c_buffer_t);
+		if (fifo_stream.overflows > 0)
+		{
+			ESP_LOGW(TAG, "FIFO overflowed %lu times", fifo_stream.overflows);
 		}
+#endif
 	}
 }
 
+/**
+ * @brief Check if the FFT buffers still hold the spectrum of a published single channel capture
+ *
+ * A spectrum calculated before an FFT setting command (mode, window, encoding, cores, length) is never resent.
+ *
+ * @param capture_id capture id
+ * @param capture capture buffer
+ * @param published true if the capture was PUBLISHED before it was claimed
+ * @return true if the spectrum can be sent again without recalculating it
+ */
+static bool fft_spectrum_cached(int capture_id, const captureBufferType *capture, bool published)
+{
+	return published && fft_spectrum_capture == capture_id && fft_spectrum_generation == fft_settings_generation &&
+		   capture->n_channels == 1;
+}
+
+/**
+ * @brief Calculate the spectrum of raw samples and rank its most significant components
+ *
+ * Results are left in fft_complex_arr and indexed_magnitudes (fft_peak_list with FFT_ENCODING_PEAKS)
+ * for task_uart_fft_components, fft_result_info.peaks tells which one.
+ * The sc16 path works on the raw counts in the same buffers and converts only the results to float.
+ *
+ * @param samples raw counts of one channel
+ * @param bias raw count offset of the channel
+ * @param scale physical units per raw count
+ * @param n_samples number of samples (power of 2, <= N_SAMPLES)
+ * @return number of ranked most significant components (number of peaks)
+ */
+static uint32_t fft_calculate_channel(const int16_t *samples, float bias, float scale, uint32_t n_samples)
+{
+	uint32_t magnitudes_size = n_samples / 2;
+	uint32_t n_ms_components = fft_percentile_n_components(FFT_MS_PERCENTILE, magnitudes_size);
+
+	if (fft_get_mode() == FFT_MODE_SC16)
+	{
+		int16_t *sc16_arr = (int16_t *)fft_complex_arr;
+		indexed_uint_type *indexed_powers = (indexed_uint_type *)indexed_magnitudes;
+
+		int shift = fft_sc16_prepare(samples, bias, sc16_arr, n_samples);
+		fft_sc16_calculate_re_im(sc16_arr, n_samples);
+		fft_sc16_calculate_powers(indexed_powers, sc16_arr, magnitudes_size);
+		fft_sc16_select_top_powers(indexed_powers, magnitudes_size, n_ms_components);
+		fft_sc16_to_fc32(sc16_arr, indexed_powers, n_samples, n_ms_components, shift, scale);
+		fft_result_info.peaks = false;
+		return n_ms_components;
+	}
+
+	// Convert raw counts of the channel to g (deg/s) while copying them to the complex array
+	fft_prepare_complex_arr_raw(samples, bias, scale, fft_complex_arr, n_samples);
+	// ESP_LOGI(TAG, "Window prepared and data merged to fft_components");
+
+	fft_calculate_re_im(fft_complex_arr, n_samples);
+	// // ESP_LOGI(TAG, "FFT calculated");
+
+	fft_calculate_powers(fft_power_arr, fft_complex_arr, magnitudes_size);
+
+	// With FFT_ENCODING_PEAKS the spectrum is reduced to its interpolated peaks instead of ranked bins
+	fft_result_info.peaks = (fft_get_encoding() == FFT_ENCODING_PEAKS);
+	if (fft_result_info.peaks)
+	{
+		fft_peaks_find(&fft_peak_list, fft_power_arr, magnitudes_size, fft_result_info.sample_rate_hz);
+		return fft_peak_list.n_peaks;
+	}
+
+	// Only the most significant components get sent, so there is no need to sort the whole array
+	// and only those get converted to magnitudes
+	fft_select_top_powers(indexed_magnitudes, fft_power_arr, magnitudes_size, n_ms_components);
+	return n_ms_components;
+}
+
 void task_fft_calculation(void *params)
 {
 	const char *TAG = "TSK FFT CALC";
-	const char *MSG_A_RDY = "A FFTRDY"; // FFT data A ready
-	const char *MSG_B_RDY = "B FFTRDY"; // FFT data B ready
+	char ready_msg[UART_FRAME_STATUS_MAX_LEN]; // "<capture letter> FFTRDY", FFT data ready
+	const char *MSG_S_RDY = "S FFTRDY"; // FFT of a stream window ready
 	FFTQueueMessage_type data_in_queue;
 
 	while (1)
 	{
 		if (xQueueReceive(queue_fft_calculation, &data_in_queue, portMAX_DELAY))
 		{
-			if (data_in_queue.array_ptr == NULL)
+			if (data_in_queue.stream_window)
+			{
+				// Copy the window first, the sampling task overwrites it after two more hops
+				if (stream_ring_copy_window(&stream_ring, data_in_queue.window_start, stream_window_arr, STREAM_WINDOW_SIZE) != 0)
+				{
+					stream_ring.windows_overwritten++;
+					continue;
+				}
+				// Stream results overwrite the spectrum of a capture in the FFT buffers
+				fft_spectrum_capture = -1;
+				fft_calculate_channel(stream_window_arr, stream_ring.bias, stream_ring.scale, STREAM_WINDOW_SIZE);
+				uart_frame_send_status(MSG_S_RDY);
+
+				fft_result_info.n_samples = STREAM_WINDOW_SIZE;
+				fft_result_info.source = FFT_SOURCE_STREAM;
+				fft_result_info.channel = stream_ring.channel;
+				xTaskNotifyGive(handl_uart_fft_components);
+				xSemaphoreTake(semphr_fft_sent, portMAX_DELAY);
+				continue;
+			}
+
+			// The message handler moved the capture to PROCESSING, it does not change until it is published
+			captureBufferType *capture = data_in_queue.capture;
+			if (capture == NULL)
 				continue;
-			// Copy sampled data to the complex array. Re parts only, im all to zero.
-			fft_prepare_complex_arr(data_in_queue.array_ptr, fft_complex_arr, N_SAMPLES);
-			// ESP_LOGI(TAG, "Window prepared and data merged to fft_components");
 
-			fft_calculate_re_im(fft_complex_arr, N_SAMPLES);
-			// // ESP_LOGI(TAG, "FFT calculated");
+			// A single channel spectrum is still in the FFT buffers, send it again without recalculating
+			bool resend = fft_spectrum_cached(data_in_queue.capture_id, capture, data_in_queue.published);
+			uint32_t settings_generation = fft_settings_generation;
 
-			fft_calculate_magnitudes(indexed_magnitudes, fft_complex_arr, MAGNITUDES_SIZE);
+			// Channels are calculated and sent one after another in ascending channel order
+			for (int slot = 0; slot < capture->n_channels; slot++)
+			{
+				if (!resend)
+				{
+					fft_calculate_channel(capture->samples[slot], capture->bias[slot], capture->scale[slot], capture->n_samples);
+
+					if (slot == 0)
+					{
+						fft_spectrum_capture = -1;
+						snprintf(ready_msg, sizeof(ready_msg), "%c FFTRDY", 'A' + data_in_queue.capture_id);
+						uart_frame_send_status(ready_msg);
+					}
+				}
 
-			fft_sort_magnitudes(indexed_magnitudes, MAGNITUDES_SIZE);
+				// Wait until the components are sent, the next channel overwrites the FFT buffers
+				fft_result_info.n_samples = capture->n_samples;
+				fft_result_info.source = FFT_SOURCE_CAPTURE(data_in_queue.capture_id);
+				fft_result_info.channel = capture->channels[slot];
+				xTaskNotifyGive(handl_uart_fft_components);
+				xSemaphoreTake(semphr_fft_sent, portMAX_DELAY);
+			}
 
 			if (DEBUG_STACKS == 1)
 			{
@@ -261,20 +613,12 @@ void task_fft_calculation(void *params)
 				ESP_LOGD(TAG, "Free stack size: %u B", stack_hwm);
 				ESP_LOGD(TAG, "Stack in use: %u of %u B", (TASK_FFT_CALC_STACK_SIZE - stack_hwm), TASK_FFT_CALC_STACK_SIZE);
 			}
-
-			if (data_in_queue.array_number == 0)
-			{
-				fft_ready_a = true;
-				fft_ready_b = false;
-				uart_write_bytes(UART_NUM, MSG_A_RDY, strlen(MSG_A_RDY));
-			}
-			else
+			if (capture->n_channels == 1 && !resend)
 			{
-				fft_ready_a = false;
-				fft_ready_b = true;
-				uart_write_bytes(UART_NUM, MSG_B_RDY, strlen(MSG_B_RDY));
+				fft_spectrum_generation = settings_generation;
+				fft_spectrum_capture = data_in_queue.capture_id;
 			}
-			xTaskNotifyGive(handl_uart_fft_components);
+			capture_state_transition(&capture->state, CAPTURE_STATE_PROCESSING, CAPTURE_STATE_PUBLISHED);
 		}
 	}
 }
@@ -285,10 +629,15 @@ void task_uart_fft_components(void *params)
 
 	while (1)
 	{
+		// fft_result_info describes the results in the FFT buffers
 		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-		uint32_t n_ms_components = fft_percentile_n_components(99, MAGNITUDES_SIZE);
+		uint32_t n_ms_components = fft_percentile_n_components(FFT_MS_PERCENTILE, fft_result_info.n_samples / 2);
 
-		int error_code = fft_send_ms_components_over_uart(fft_complex_arr, indexed_magnitudes, N_SAMPLES, n_ms_components);
+		int error_code = 0;
+		if (fft_result_info.peaks)
+			error_code = fft_send_peaks_over_uart(&fft_peak_list, &fft_result_info);
+		else
+			error_code = fft_send_ms_components_over_uart(fft_complex_arr, indexed_magnitudes, &fft_result_info, n_ms_components);
 		if (error_code != 0)
 			ESP_LOGE(TAG, "Error %d", error_code);
 
@@ -302,51 +651,187 @@ void task_uart_fft_components(void *params)
 		// ESP_LOGI(TAG, "FFT components sent");
 		// xTaskNotifyGive(handl_uart_data_samples);
 		xSemaphoreGive(semphr_uart_request);
+		xSemaphoreGive(semphr_fft_sent);
 	}
 }
 
+/**
+ * @brief Send all channels of a capture as RAW_SAMPLES (RAW_SAMPLES_RICE) frames
+ *
+ * Frames are copied to the UART TX ring buffer, so only the wire speed limits the dump.
+ * Compressed chunks that do not get smaller than the raw counts are sent as RAW_SAMPLES frames.
+ *
+ * @param capture_id capture buffer id
+ * @param compressed Rice code the counts
+ * @param bytes_sent frame bytes written to the UART
+ * @return 0 OK
+ * @return <0 capture_buffer_encode_chunk or uart_frame_send_buffer error
+ */
+static int uart_dump_capture(uint32_t capture_id, bool compressed, size_t *bytes_sent)
+{
+	static uint8_t dump_frame[RAW_DUMP_FRAME_SIZE]; // Too large for the task stack
+	captureBufferType *capture = &capture_pool[capture_id];
+	uint8_t source = FFT_SOURCE_CAPTURE(capture_id);
+	int error_code = 0;
+
+	*bytes_sent = 0;
+	// Channels are sent one after another in ascending channel order, each in RAW_DUMP_CHUNK_SAMPLES chunks
+	for (int slot = 0; slot < capture->n_channels; slot++)
+	{
+		for (size_t offset = 0; offset < capture->n_samples; offset += RAW_DUMP_CHUNK_SAMPLES)
+		{
+			size_t count = (capture->n_samples - offset < RAW_DUMP_CHUNK_SAMPLES) ? (capture->n_samples - offset) : RAW_DUMP_CHUNK_SAMPLES;
+			uint8_t frame_type = UART_FRAME_TYPE_RAW_SAMPLES_RICE;
+			int payload_len = -3;
+			if (compressed)
+				payload_len = capture_buffer_encode_chunk(capture, slot, source, offset, count, true, &dump_frame[UART_FRAME_HEADER_SIZE], sizeof(dump_frame) - UART_FRAME_OVERHEAD);
+			if (payload_len == -3)
+			{
+				frame_type = UART_FRAME_TYPE_RAW_SAMPLES;
+				payload_len = capture_buffer_encode_chunk(capture, slot, source, offset, count, false, &dump_frame[UART_FRAME_HEADER_SIZE], sizeof(dump_frame) - UART_FRAME_OVERHEAD);
+			}
+			if (payload_len < 0)
+				return payload_len;
+			if ((error_code = uart_frame_send_buffer(dump_frame, sizeof(dump_frame), frame_type, payload_len)) != 0)
+				return error_code;
+			*bytes_sent += payload_len + UART_FRAME_OVERHEAD;
+		}
+	}
+	return 0;
+}
+
 void task_uart_data_samples(void *params)
 {
-	// const char *TAG = "TSK SEND DATA";
+	const char *TAG = "TSK SEND DATA";
+	char dump_msg[UART_FRAME_STATUS_MAX_LEN];
+	uint32_t dump_requests = 0;
 
 	while (1)
 	{
-		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-		uart_write_bytes(UART_NUM, "\xfe\xfe\xfe\xfe\xff", 5);
-		if (data_ready_a && fft_ready_a)
+		// Notification bit n requests a dump of capture n (bit n + 16: Rice compressed),
+		// the handler moved the capture to PROCESSING and the dump returns it to its previous state
+		xTaskNotifyWait(0, UINT32_MAX, &dump_requests, portMAX_DELAY);
+		for (uint32_t capture_id = 0; capture_id < CAPTURE_POOL_SIZE; capture_id++)
 		{
-			for (size_t i = 0; i < N_SAMPLES; i++)
+			if ((dump_requests & (1 << capture_id)) == 0)
+				continue;
+
+			size_t bytes_sent = 0;
+			int64_t start_us = esp_timer_get_time();
+			int error_code = uart_dump_capture(capture_id, (dump_requests & (1 << (capture_id + 16))) != 0, &bytes_sent);
+			uart_wait_tx_done(UART_NUM, portMAX_DELAY);
+			int64_t elapsed_us = esp_timer_get_time() - start_us;
+
+			// The capture may be overwritten again
+			capture_state_transition(&capture_pool[capture_id].state, CAPTURE_STATE_PROCESSING, capture_dump_return_state[capture_id]);
+
+			if (error_code != 0)
 			{
-				uart_write_bytes(UART_NUM, (const char *)&data_samples_a[i], sizeof(float));
+				ESP_LOGE(TAG, "Raw dump error %d", error_code);
+				uart_frame_send_status("DUMP FAIL");
+				continue;
 			}
+			uint32_t bytes_per_s = (elapsed_us > 0) ? (uint32_t)((int64_t)bytes_sent * 1000000 / elapsed_us) : 0;
+			snprintf(dump_msg, sizeof(dump_msg), "%c DUMP %u B %lu B/s", 'A' + capture_id, (unsigned)bytes_sent, (unsigned long)bytes_per_s);
+			uart_frame_send_status(dump_msg);
+			ESP_LOGI(TAG, "%s (wire limit %d B/s)", dump_msg, UART_BAUD / 10);
+		}
+
+		if (DEBUG_STACKS == 1)
+		{
+			UBaseType_t stack_hwm = uxTaskGetStackHighWaterMark(NULL);
+			ESP_LOGD(TAG, "Free stack size: %u B", stack_hwm);
+			ESP_LOGD(TAG, "Stack in use: %u of %u B", (TASK_SEND_DATA_SAMPLES_STACK_SIZE - stack_hwm), TASK_SEND_DATA_SAMPLES_STACK_SIZE);
 		}
-		else if (data_ready_b && fft_ready_b)
+	}
+}
+
+void task_uart_goertzel(void *params)
+{
+	const char *TAG = "TSK SEND GOERTZEL";
+	static uint8_t goertzel_frame[GOERTZEL_FRAME_SIZE];
+	goertzelResultType result;
+
+	while (1)
+	{
+		// One frame per completed block of the Goertzel bank
+		if (xQueueReceive(queue_goertzel_results, &result, portMAX_DELAY))
 		{
-			for (size_t i = 0; i < N_SAMPLES; i++)
+			int payload_len = goertzel_bank_encode_result(&result, &goertzel_frame[UART_FRAME_HEADER_SIZE], sizeof(goertzel_frame) - UART_FRAME_OVERHEAD);
+			if (payload_len < 0 || uart_frame_send_buffer(goertzel_frame, sizeof(goertzel_frame), UART_FRAME_TYPE_GOERTZEL, payload_len) < 0)
 			{
-				uart_write_bytes(UART_NUM, (const char *)&data_samples_b[i], sizeof(float));
+				ESP_LOGE(TAG, "Failed to send Goertzel block %lu", result.block_index);
 			}
 		}
-		uart_write_bytes(UART_NUM, "\xff\xfe\xfe\xfe\xfe", 5);
-
-		// if (DEBUG_STACKS == 1)
-		// {
-		// 	UBaseType_t stack_hwm = uxTaskGetStackHighWaterMark(NULL);
-		// 	ESP_LOGI(TAG, "Free stack size: %u B", stack_hwm);
-		// 	ESP_LOGI(TAG, "Stack in use: %u of %u B", (TASK_SEND_DATA_SAMPLES_STACK_SIZE - stack_hwm), TASK_SEND_DATA_SAMPLES_STACK_SIZE);
-		// 	ESP_LOGI(TAG, "Data samples sent");
-		// }
-		xSemaphoreGive(semphr_uart_request);
 	}
 }
 
+void task_fft_benchmark(void *params)
+{
+	const char *TAG = "TSK FFT BENCH";
+	const uint32_t bench_sizes[] = {N_SAMPLES_16, N_SAMPLES_32};
+	fft_bench_result_type result;
+	int error_code = 0;
+
+	int16_t *signal_arr = (int16_t *)heap_caps_malloc(N_SAMPLES * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+	if (signal_arr == NULL)
+	{
+		ESP_LOGE(TAG, "Failed to allocate memory for signal_arr");
+		handl_fft_benchmark = NULL;
+		vTaskDelete(NULL);
+	}
+
+	for (size_t i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); i++)
+	{
+		if (bench_sizes[i] > N_SAMPLES)
+			continue;
+
+		// Synthetic signal
+		fft_bench_generate_signal(signal_arr, bench_sizes[i]);
+		if ((error_code = fft_bench_run(signal_arr, 0.0f, 1.0f / MPU_ACCEL_FS, bench_sizes[i], FFT_BENCH_ITERATIONS, &result)) != 0)
+			ESP_LOGE(TAG, "Synthetic benchmark error %d", error_code);
+		else
+			fft_bench_print_result("synthetic", &result);
+
+		// Recorded signals (first captured channel), if a complete capture of this length is available
+		for (uint32_t capture_id = 0; capture_id < CAPTURE_POOL_SIZE; capture_id++)
+		{
+			captureBufferType *capture = &capture_pool[capture_id];
+			capture_state_type previous_state;
+			if (!capture_state_claim(&capture->state, CAPTURE_STATES_COMPLETE, CAPTURE_STATE_PROCESSING, &previous_state))
+				continue;
+			bool complete = bench_sizes[i] <= capture->n_samples;
+			if (complete)
+				memcpy(signal_arr, capture->samples[0], bench_sizes[i] * sizeof(int16_t));
+			float bias = capture->bias[0];
+			float scale = capture->scale[0];
+			capture_state_transition(&capture->state, CAPTURE_STATE_PROCESSING, previous_state);
+			if (!complete)
+				continue;
+
+			char name[16];
+			snprintf(name, sizeof(name), "recorded %c", 'A' + capture_id);
+			if ((error_code = fft_bench_run(signal_arr, bias, scale, bench_sizes[i], FFT_BENCH_ITERATIONS, &result)) != 0)
+				ESP_LOGE(TAG, "%s benchmark error %d", name, error_code);
+			else
+				fft_bench_print_result(name, &result);
+		}
+	}
+
+	heap_caps_free(signal_arr);
+	uart_frame_send_status("BENCH DONE");
+	handl_fft_benchmark = NULL;
+	vTaskDelete(NULL);
+}
+
 void task_uart_isr_monitoring(void *params)
 {
 	const char *TAG = "UART ISR TASK";
 
 	uart_event_t uart_event;
 	int error_flag = 0;
-	int encapsulation_counter = 0;
+
+	uart_rx_parser_reset(&uart_rx_parser);
 
 	while (1)
 	{
@@ -356,24 +841,29 @@ void task_uart_isr_monitoring(void *params)
 			switch (uart_event.type)
 			{
 			/**
-			 * @brief Pattern detection case
+			 * @brief Received bytes
 			 *
-			 * Multiple identical characters of specific type detected in a row.
-			 * Number of chars is defined with macro UART_PATTERN_SIZE
+			 * The bytes are parsed as they arrive, frames may be split between events.
 			 */
-			case UART_PATTERN_DET:
-				int pattern_index = uart_pattern_pop_pos(UART_NUM);
-				if (pattern_index == -1)
+			case UART_DATA:
+				if ((error_flag = myuart_receive_data(UART_NUM, &uart_rx_parser, uart_event.size)) < 0)
 				{
-					ESP_LOGE(TAG, "Pattern index -1");
-					break;
-				}
-				if ((error_flag = myuart_encapsulation_handler(UART_NUM, &encapsulation_counter, &pattern_index)) < 0)
-				{
-					ESP_LOGE(TAG, "Uart encapsulation handler error %d", error_flag);
+					ESP_LOGE(TAG, "Uart receive error %d", error_flag);
 				}
 				break;
 
+			/**
+			 * @brief RX overflow
+			 *
+			 * Bytes were lost, the frame in progress is incomplete. Drop everything and hunt for the next start flag.
+			 */
+			case UART_FIFO_OVF:
+			case UART_BUFFER_FULL:
+				uart_flush_input(UART_NUM);
+				xQueueReset(queue_uart_event_queue);
+				uart_rx_parser_reset_error(&uart_rx_parser);
+				break;
+
 			default:
 				break;
 			}
@@ -383,172 +873,519 @@ void task_uart_isr_monitoring(void *params)
 	vTaskDelete(NULL);
 }
 
-void task_queue_msg_handler(void *params)
+/**
+ * @brief Parse the optional hex channel mask that follows a start command ("A START 3F")
+ *
+ * @param args arguments of the command
+ * @param channel_mask parsed mask, CAPTURE_DEFAULT_CHANNELS if the argument is missing
+ * @return true if the argument is missing or a valid hex byte
+ */
+static bool msg_parse_channel_mask(const char *args, uint8_t *channel_mask)
 {
-	const char *TAG = "TSK QUEUE MSG HANDL";
-	FFTQueueMessage_type fft_queue_msg_a = {
-		.array_number = 0,
-		.array_ptr = data_samples_a};
+	if (*args == '\0')
+	{
+		*channel_mask = CAPTURE_DEFAULT_CHANNELS;
+		return true;
+	}
 
-	FFTQueueMessage_type fft_queue_msg_b = {
-		.array_number = 1,
-		.array_ptr = data_samples_b};
+	char *arg_end = NULL;
+	unsigned long value = strtoul(args, &arg_end, 16);
+	if (arg_end == args || *arg_end != '\0' || value > 0xFF)
+		return false;
+	*channel_mask = (uint8_t)value;
+	return true;
+}
 
-	TaskQueueMessage_type enqueued_message;
+/**
+ * @brief Parse the hex channel mask and the frequencies that follow a command ("GOERTZEL 01 24.5 49 98")
+ *
+ * @param args arguments of the command
+ * @param channel_mask parsed CAPTURE_CH_* mask
+ * @param freqs_hz array that receives up to GOERTZEL_MAX_FREQS frequencies in Hz
+ * @return number of parsed frequencies
+ * @return -1 missing or malformed arguments, or more than GOERTZEL_MAX_FREQS frequencies
+ */
+static int msg_parse_goertzel_args(const char *args, uint8_t *channel_mask, float *freqs_hz)
+{
+	char *arg_end = NULL;
+	unsigned long mask = strtoul(args, &arg_end, 16);
+	if (arg_end == args || (*arg_end != ' ' && *arg_end != '\0') || mask > 0xFF)
+		return -1;
+	*channel_mask = (uint8_t)mask;
+
+	int n_freqs = 0;
+	const char *arg = arg_end;
+	while (1)
+	{
+		while (*arg == ' ')
+			arg++;
+		if (*arg == '\0')
+			break;
+		if (n_freqs == GOERTZEL_MAX_FREQS)
+			return -1;
+		freqs_hz[n_freqs] = strtof(arg, &arg_end);
+		if (arg_end == arg || (*arg_end != ' ' && *arg_end != '\0'))
+			return -1;
+		n_freqs++;
+		arg = arg_end;
+	}
+	return n_freqs;
+}
+
+/**
+ * @brief Parse the decimal capture length that follows a command ("N 4096")
+ *
+ * @param args arguments of the command
+ * @param n_samples parsed length, unchanged if there is no argument
+ * @return true if there is no argument or a valid length was parsed
+ */
+static bool msg_parse_length(const char *args, uint32_t *n_samples)
+{
+	if (*args == '\0')
+		return true;
+
+	char *arg_end = NULL;
+	unsigned long value = strtoul(args, &arg_end, 10);
+	if (arg_end == args || *arg_end != '\0' || capture_buffer_check_length(value) != 0)
+		return false;
+	*n_samples = (uint32_t)value;
+	return true;
+}
+
+/**
+ * @brief Get the capture id of a capture command from its A / B alias or its first argument ("START 2 07", "SEND C")
+ *
+ * @param command matched command, context is the id or MSG_CAPTURE_ID_ARG
+ * @param args arguments of the command, advanced past the id
+ * @param capture_id parsed id (0..CAPTURE_POOL_SIZE-1)
+ * @return true if the id is valid
+ */
+static bool msg_parse_capture_id(const MsgCommand_type *command, const char **args, uint32_t *capture_id)
+{
+	if (command->context != MSG_CAPTURE_ID_ARG)
+	{
+		*capture_id = command->context;
+		return true;
+	}
+
+	const char *arg = *args;
+	char *arg_end = (char *)arg + 1;
+	if (arg[0] >= 'A' && arg[0] < 'A' + CAPTURE_POOL_SIZE && (arg[1] == ' ' || arg[1] == '\0'))
+	{
+		*capture_id = arg[0] - 'A';
+	}
+	else
+	{
+		unsigned long value = strtoul(arg, &arg_end, 10);
+		if (arg_end == arg || (*arg_end != ' ' && *arg_end != '\0') || value >= CAPTURE_POOL_SIZE)
+			return false;
+		*capture_id = (uint32_t)value;
+	}
+	while (*arg_end == ' ')
+		arg_end++;
+	*args = arg_end;
+	return true;
+}
+
+/**
+ * @brief Send a status message of a capture ("A SAMPLING", "C NOTRDY")
+ *
+ * @param capture_id capture buffer id, named by the letters A, B, C, ...
+ * @param status status text without the capture letter
+ */
+static void msg_send_capture_status(uint32_t capture_id, const char *status)
+{
+	char status_msg[UART_FRAME_STATUS_MAX_LEN];
+	snprintf(status_msg, sizeof(status_msg), "%c %s", 'A' + capture_id, status);
+	uart_frame_send_status(status_msg);
+}
+
+// WHOAMI, replies MPU6050
+static void cmd_whoami(const MsgCommand_type *command, const char *args)
+{
+	uart_frame_send_status("MPU6050");
+}
+
+// START <id> / A START / B START (optional hex channel mask argument, "START 2 07"), replies SAMPLING, QUEUED, BUSY or FAIL
+static void cmd_capture_start(const MsgCommand_type *command, const char *args)
+{
+	uint32_t capture_id;
+	uint8_t channel_mask;
+
+	if (!msg_parse_capture_id(command, &args, &capture_id) || !msg_parse_channel_mask(args, &channel_mask) || capture_buffer_check_channels(channel_mask) != 0)
+	{
+		uart_frame_send_status("FAIL");
+		return;
+	}
+
+	captureBufferType *capture = &capture_pool[capture_id];
+	// A buffer that is queued, sampling, or read by the FFT, a dump or the benchmark is never overwritten
+	if (capture_state_claim(&capture->state, CAPTURE_STATES_IDLE, CAPTURE_STATE_PROCESSING, NULL))
+	{
+		capture_buffer_set_channels(capture, channel_mask, &mpu_data_t);
+		capture_buffer_set_length(capture, capture_n_samples);
 
-	// START SAMPLING
-	const char *A_START = "A START";
-	const char *B_START = "B START";
-	// STARTED SAMPLING CONFIRMATION
-	const char *A_SAMPLING = "A SAMPLING";
-	const char *B_SAMPLING = "B SAMPLING";
-	// SEND DATA
-	const char *A_SEND = "A SEND";
-	const char *B_SEND = "B SEND";
-	// SAMPLING BUSY
-	const char *A_BUSY = "A BUSY";
-	const char *B_BUSY = "B BUSY";
-	// CONFIRMING DATA SEND
-	const char *A_OK = "A OK";
-	const char *B_OK = "B OK";
-	// DATA NOT READY
-	const char *A_NOTRDY = "A NOTRDY";
-	const char *B_NOTRDY = "B NOTRDY";
-	// COMMON
-	const char *FFT = "FFT";
-	const char *FAIL = "FAIL";
-	const char *WHOAMI = "WHOAMI";
-	const char *DEVID = "MPU6050";
-	// When data is ready sampling task sends A DATRDY or B DATRDY
-	// When FFT is done calculating, fft task sends A FFTOK or B FFTOK
+		// Captures are recorded one after another, this one starts when the ones started before it are full
+		bool queued = capture_pool_recording();
+		uint8_t queued_id = (uint8_t)capture_id;
+		capture_state_transition(&capture->state, CAPTURE_STATE_PROCESSING, CAPTURE_STATE_QUEUED);
+		xQueueSend(queue_capture_start, &queued_id, 0); // every capture is queued at most once, the queue never fills
+		// Always notified: the sampling task may have finished the last capture since any check made here
+		xTaskNotifyGive(handl_mpu_sampling_begin);
+		msg_send_capture_status(capture_id, queued ? "QUEUED" : "SAMPLING");
+	}
+	else
+	{
+		msg_send_capture_status(capture_id, "BUSY");
+	}
+}
+
+// SEND <id> / A SEND / B SEND, replies OKFFT (new calculation), OK (single channel resend), NOTRDY, BUSY or FFTFAIL
+static void cmd_capture_send(const MsgCommand_type *command, const char *args)
+{
+	uint32_t capture_id;
+	capture_state_type previous_state;
+
+	if (!msg_parse_capture_id(command, &args, &capture_id))
+	{
+		uart_frame_send_status("FAIL");
+		return;
+	}
+	captureBufferType *capture = &capture_pool[capture_id];
+	if (!capture_state_claim(&capture->state, CAPTURE_STATES_COMPLETE, CAPTURE_STATE_PROCESSING, &previous_state))
+	{
+		msg_send_capture_status(capture_id, (previous_state == CAPTURE_STATE_PROCESSING) ? "BUSY" : "NOTRDY");
+		return;
+	}
+
+	FFTQueueMessage_type fft_queue_msg = {
+		.capture_id = capture_id,
+		.capture = capture,
+		.published = (previous_state == CAPTURE_STATE_PUBLISHED)};
+	bool resend = fft_spectrum_cached((int)capture_id, capture, fft_queue_msg.published);
+
+	// Queued captures are transformed back to back, a single channel result is sent again without recalculating it
+	if (xQueueSend(queue_fft_calculation, &fft_queue_msg, 0) == pdTRUE)
+	{
+		msg_send_capture_status(capture_id, resend ? "OK" : "OKFFT");
+	}
+	else
+	{
+		capture_state_transition(&capture->state, CAPTURE_STATE_PROCESSING, previous_state);
+		uart_frame_send_status("FFTFAIL");
+	}
+}
+
+// DUMP <id> / A DUMP / B DUMP (optional "RICE" argument for compressed counts), replies DUMPING, NOTRDY, BUSY or FAIL
+static void cmd_capture_dump(const MsgCommand_type *command, const char *args)
+{
+	uint32_t capture_id;
+	capture_state_type previous_state;
+
+	if (!msg_parse_capture_id(command, &args, &capture_id))
+	{
+		uart_frame_send_status("FAIL");
+		return;
+	}
+	captureBufferType *capture = &capture_pool[capture_id];
+	// PROCESSING keeps "START" from overwriting the buffer during the dump
+	if (capture_state_claim(&capture->state, CAPTURE_STATES_COMPLETE, CAPTURE_STATE_PROCESSING, &previous_state))
+	{
+		capture_dump_return_state[capture_id] = previous_state;
+		msg_send_capture_status(capture_id, "DUMPING");
+		uint32_t dump_request = (1 << capture_id) | ((strcmp(args, "RICE") == 0) ? (1 << (16 + capture_id)) : 0);
+		xTaskNotify(handl_uart_data_samples, dump_request, eSetBits);
+	}
+	else
+	{
+		msg_send_capture_status(capture_id, (previous_state == CAPTURE_STATE_PROCESSING) ? "BUSY" : "NOTRDY");
+	}
+}
+
+// STREAM START (optional hex mask of one channel, "STREAM START 01"), replies STREAM ON, STREAM BUSY or FAIL
+static void cmd_stream_start(const MsgCommand_type *command, const char *args)
+{
+	uint8_t channel_mask;
+
+	if (streaming)
+	{
+		uart_frame_send_status("STREAM BUSY");
+	}
+	else if (!msg_parse_channel_mask(args, &channel_mask) ||
+			 capture_buffer_check_channels(channel_mask) != 0 || (channel_mask & (channel_mask - 1)) != 0)
+	{
+		uart_frame_send_status("FAIL");
+	}
+	else
+	{
+		stream_ring_reset(&stream_ring, __builtin_ctz(channel_mask), &mpu_data_t);
+		// Set before the notify, the sampling task may have finished its last capture at any point before
+		streaming = true;
+		xTaskNotifyGive(handl_mpu_sampling_begin);
+		uart_frame_send_status("STREAM ON");
+	}
+}
+
+// STREAM STOP, replies STREAM OFF
+static void cmd_stream_stop(const MsgCommand_type *command, const char *args)
+{
+	const char *TAG = "CMD STREAM STOP";
+
+	streaming = false;
+	// Each counter has a single writer, so no count is lost between the cores
+	uint32_t windows_lost = stream_ring.windows_dropped + stream_ring.windows_overwritten;
+	if (windows_lost > 0)
+		ESP_LOGW(TAG, "Stream dropped %lu windows", windows_lost);
+	uart_frame_send_status("STREAM OFF");
+}
+
+// GOERTZEL ("GOERTZEL 01 24.5 49 98", hex channel mask and up to GOERTZEL_MAX_FREQS frequencies in Hz), replies GOERTZEL ON, GOERTZEL BUSY or FAIL
+static void cmd_goertzel_start(const MsgCommand_type *command, const char *args)
+{
+	float freqs_hz[GOERTZEL_MAX_FREQS];
+	uint8_t channel_mask = 0;
+	int n_freqs = msg_parse_goertzel_args(args, &channel_mask, freqs_hz);
+
+	if (goertzel_running)
+	{
+		uart_frame_send_status("GOERTZEL BUSY");
+	}
+	else if (n_freqs <= 0 || capture_buffer_check_channels(channel_mask) != 0 || (channel_mask & (channel_mask - 1)) != 0 ||
+			 goertzel_bank_configure(&goertzel_bank, __builtin_ctz(channel_mask), freqs_hz, n_freqs, GOERTZEL_BLOCK_SIZE, &mpu_data_t) != 0)
+	{
+		uart_frame_send_status("FAIL");
+	}
+	else
+	{
+		// Set before the notify, the sampling task may have finished its last capture at any point before
+		goertzel_running = true;
+		xTaskNotifyGive(handl_mpu_sampling_begin);
+		uart_frame_send_status("GOERTZEL ON");
+	}
+}
+
+// GOERTZEL STOP, replies GOERTZEL OFF
+static void cmd_goertzel_stop(const MsgCommand_type *command, const char *args)
+{
+	const char *TAG = "CMD GOERTZEL STOP";
+
+	goertzel_running = false;
+	if (goertzel_bank.blocks_dropped > 0)
+		ESP_LOGW(TAG, "Goertzel bank dropped %lu blocks", goertzel_bank.blocks_dropped);
+	uart_frame_send_status("GOERTZEL OFF");
+}
+
+// FFT SC16 / FFT FC32, replies the command or FAIL
+static void cmd_fft_mode(const MsgCommand_type *command, const char *args)
+{
+	int error_code = fft_set_mode((fft_mode_type)command->context);
+	if (error_code == 0)
+		fft_settings_generation++;
+	uart_frame_send_status((error_code == 0) ? command->name : "FAIL");
+}
+
+// FFT WIN ("FFT WIN HANN", RECT / HANN / HAMMING / BH / FLATTOP), replies "FFT WIN <name>" or FAIL
+static void cmd_fft_window(const MsgCommand_type *command, const char *args)
+{
+	const char *FFT_WIN_NAMES[] = {"RECT", "HANN", "HAMMING", "BH", "FLATTOP"}; // fft_window_type order
+
+	int window = FFT_WINDOW_FLAT_TOP;
+	while (window >= FFT_WINDOW_RECT && strcmp(args, FFT_WIN_NAMES[window]) != 0)
+		window--;
+	if (window >= FFT_WINDOW_RECT && fft_set_window((fft_window_type)window) == 0)
+	{
+		char win_msg[UART_FRAME_STATUS_MAX_LEN];
+		fft_settings_generation++;
+		snprintf(win_msg, sizeof(win_msg), "%s %s", command->name, FFT_WIN_NAMES[window]);
+		uart_frame_send_status(win_msg);
+	}
+	else
+		uart_frame_send_status("FAIL");
+}
+
+// FFT PACKED / FFT RAW / FFT PEAKS, replies the command or FAIL
+static void cmd_fft_encoding(const MsgCommand_type *command, const char *args)
+{
+	int error_code = fft_set_encoding((fft_encoding_type)command->context);
+	if (error_code == 0)
+		fft_settings_generation++;
+	uart_frame_send_status((error_code == 0) ? command->name : "FAIL");
+}
+
+// FFT DUAL / FFT SINGLE, replies the command or FAIL
+static void cmd_fft_cores(const MsgCommand_type *command, const char *args)
+{
+	int error_code = fft_set_dual_core(command->context != 0);
+	if (error_code == 0)
+		fft_settings_generation++;
+	uart_frame_send_status((error_code == 0) ? command->name : "FAIL");
+}
+
+// N <value> (power of 2 from CAPTURE_MIN_SAMPLES to N_SAMPLES, applies to the next START <id>), "N" reports the current length
+static void cmd_capture_length(const MsgCommand_type *command, const char *args)
+{
+	uint32_t n_samples = capture_n_samples;
+
+	if (msg_parse_length(args, &n_samples))
+	{
+		char length_msg[UART_FRAME_STATUS_MAX_LEN];
+		if (n_samples != capture_n_samples)
+			fft_settings_generation++;
+		capture_n_samples = n_samples;
+		snprintf(length_msg, sizeof(length_msg), "%s %lu", command->name, (unsigned long)n_samples);
+		uart_frame_send_status(length_msg);
+	}
+	else
+	{
+		uart_frame_send_status("FAIL");
+	}
+}
+
+// BENCH, replies BENCH (BENCH DONE when finished), BENCH BUSY or FAIL
+static void cmd_bench(const MsgCommand_type *command, const char *args)
+{
+	if (handl_fft_benchmark != NULL)
+	{
+		uart_frame_send_status("BENCH BUSY");
+	}
+	else if (xTaskCreate(task_fft_benchmark, "FFT benchmark task", TASK_FFT_BENCH_STACK_SIZE, NULL, 10, &handl_fft_benchmark) != pdPASS)
+	{
+		handl_fft_benchmark = NULL;
+		uart_frame_send_status("FAIL");
+	}
+	else
+	{
+		uart_frame_send_status(command->name);
+	}
+}
+
+// RXSTATS, replies "RXSTATS <frames> <dropped bytes> <errors> <last latency us> <max latency us>"
+static void cmd_rx_stats(const MsgCommand_type *command, const char *args)
+{
+	const uartRxStatsType *stats = &uart_rx_parser.stats;
+	char stats_msg[UART_FRAME_STATUS_MAX_LEN];
+	uint32_t errors = stats->errors_too_long + stats->errors_empty + stats->errors_queue + stats->errors_rx;
+
+	snprintf(stats_msg, sizeof(stats_msg), "%s %lu %lu %lu %lu %lu", command->name, (unsigned long)stats->frames, (unsigned long)stats->bytes_dropped,
+			 (unsigned long)errors, (unsigned long)stats->latency_us_last, (unsigned long)stats->latency_us_max);
+	uart_frame_send_status(stats_msg);
+}
+
+#define MSG_COMMAND(name, handler, context) {name, sizeof(name) - 1, handler, context}
+
+// Command words, a command matches if the message starts with its name followed by a space or the end of the message
+static const MsgCommand_type msg_commands[] = {
+	MSG_COMMAND("WHOAMI", cmd_whoami, 0),
+	MSG_COMMAND("START", cmd_capture_start, MSG_CAPTURE_ID_ARG),
+	MSG_COMMAND("SEND", cmd_capture_send, MSG_CAPTURE_ID_ARG),
+	MSG_COMMAND("DUMP", cmd_capture_dump, MSG_CAPTURE_ID_ARG),
+	MSG_COMMAND("A START", cmd_capture_start, 0), // A / B aliases of capture ids 0 and 1
+	MSG_COMMAND("B START", cmd_capture_start, 1),
+	MSG_COMMAND("A SEND", cmd_capture_send, 0),
+	MSG_COMMAND("B SEND", cmd_capture_send, 1),
+	MSG_COMMAND("A DUMP", cmd_capture_dump, 0),
+	MSG_COMMAND("B DUMP", cmd_capture_dump, 1),
+	MSG_COMMAND("STREAM START", cmd_stream_start, 0),
+	MSG_COMMAND("STREAM STOP", cmd_stream_stop, 0),
+	MSG_COMMAND("GOERTZEL", cmd_goertzel_start, 0),
+	MSG_COMMAND("GOERTZEL STOP", cmd_goertzel_stop, 0),
+	MSG_COMMAND("FFT SC16", cmd_fft_mode, FFT_MODE_SC16),
+	MSG_COMMAND("FFT FC32", cmd_fft_mode, FFT_MODE_FC32),
+	MSG_COMMAND("FFT WIN", cmd_fft_window, 0),
+	MSG_COMMAND("FFT PACKED", cmd_fft_encoding, FFT_ENCODING_PACKED),
+	MSG_COMMAND("FFT RAW", cmd_fft_encoding, FFT_ENCODING_RAW),
+	MSG_COMMAND("FFT PEAKS", cmd_fft_encoding, FFT_ENCODING_PEAKS),
+	MSG_COMMAND("FFT DUAL", cmd_fft_cores, 1),
+	MSG_COMMAND("FFT SINGLE", cmd_fft_cores, 0),
+	MSG_COMMAND("N", cmd_capture_length, 0),
+	MSG_COMMAND("BENCH", cmd_bench, 0),
+	MSG_COMMAND("RXSTATS", cmd_rx_stats, 0),
+};
+
+/**
+ * @brief Find the command of a received message
+ *
+ * The longest matching name wins, so "GOERTZEL STOP" is not taken for "GOERTZEL" with arguments.
+ * Names are only compared up to the message length, a short message never reads past its end.
+ *
+ * @param message received message ('\0' terminated)
+ * @return matching command
+ * @return NULL unknown command
+ */
+static const MsgCommand_type *msg_find_command(const TaskQueueMessage_type *message)
+{
+	const MsgCommand_type *match = NULL;
+
+	for (size_t i = 0; i < sizeof(msg_commands) / sizeof(msg_commands[0]); i++)
+	{
+		const MsgCommand_type *command = &msg_commands[i];
+		if (command->name_len <= message->msg_size && memcmp(message->msg, command->name, command->name_len) == 0 &&
+			(message->msg[command->name_len] == ' ' || message->msg[command->name_len] == '\0') &&
+			(match == NULL || command->name_len > match->name_len))
+		{
+			match = command;
+		}
+	}
+	return match;
+}
+
+/**
+ * @brief Send the status of a sampling event ("A DATRDY", "A OVF", "FIFO OVF", "MPU ERR")
+ *
+ * @param event event posted by the sampling task
+ */
+static void msg_send_sampling_event(const SamplingEvent_type *event)
+{
+	switch (event->type)
+	{
+	case SAMPLING_EVENT_DATRDY:
+		msg_send_capture_status(event->capture_id, "DATRDY");
+		break;
+	case SAMPLING_EVENT_OVERFLOW:
+		if (event->capture_id >= 0)
+			msg_send_capture_status(event->capture_id, "OVF");
+		else
+			uart_frame_send_status("FIFO OVF");
+		break;
+	case SAMPLING_EVENT_MPU_ERROR:
+		uart_frame_send_status("MPU ERR");
+		break;
+	default:
+		break;
+	}
+}
+
+void task_queue_msg_handler(void *params)
+{
+	TaskQueueMessage_type enqueued_message;
+	SamplingEvent_type sampling_event;
 
 	while (1)
 	{
-		if (xQueueReceive(queue_enqueued_msg_processing, &enqueued_message, portMAX_DELAY))
+		QueueSetMemberHandle_t ready_queue = xQueueSelectFromSet(queue_set_msg_handler, portMAX_DELAY);
+		if (ready_queue == queue_sampling_events)
+		{
+			if (xQueueReceive(queue_sampling_events, &sampling_event, 0))
+				msg_send_sampling_event(&sampling_event);
+		}
+		else if (ready_queue == queue_enqueued_msg_processing && xQueueReceive(queue_enqueued_msg_processing, &enqueued_message, 0))
 		{
-			if (enqueued_message.msg_ptr != NULL)
+			const MsgCommand_type *command = msg_find_command(&enqueued_message);
+			if (command != NULL)
 			{
-				// WHOAMI
-				if (memcmp(enqueued_message.msg_ptr, WHOAMI, (strlen(WHOAMI))) == 0)
-				{
-					uart_write_bytes(UART_NUM, DEVID, strlen(DEVID));
-				}
-				// A START
-				else if (memcmp(enqueued_message.msg_ptr, A_START, (strlen(A_START))) == 0)
-				{
-					if (xSemaphoreTake(semphr_sampling_request_a, pdMS_TO_TICKS(10)) == pdTRUE)
-					{
-						uart_write_bytes(UART_NUM, A_SAMPLING, strlen(A_SAMPLING));
-						data_ready_a = false;
-						fft_ready_a = false;
-						if (!sampling_a && !sampling_b)
-						{
-							sampling_a = true;
-							xTaskNotifyGive(handl_mpu_sampling_begin);
-						}
-						else
-						{
-							sampling_a = true;
-						}
-					}
-					else if (!sampling_a && !data_ready_a)
-					{
-						xSemaphoreGive(semphr_sampling_request_a);
-					}
-					else
-					{
-						uart_write_bytes(UART_NUM, A_BUSY, strlen(A_BUSY));
-					}
-				}
-				// B START
-				else if (memcmp(enqueued_message.msg_ptr, B_START, (strlen(B_START))) == 0)
-				{
-					if (xSemaphoreTake(semphr_sampling_request_b, pdMS_TO_TICKS(10)) == pdTRUE)
-					{
-						uart_write_bytes(UART_NUM, B_SAMPLING, strlen(B_SAMPLING));
-						data_ready_b = false;
-						fft_ready_b = false;
-						if (!sampling_a && !sampling_b)
-						{
-							sampling_b = true;
-							xTaskNotifyGive(handl_mpu_sampling_begin);
-						}
-						else
-							sampling_b = true;
-					}
-					else if (!sampling_b && !data_ready_b)
-					{
-						xSemaphoreGive(semphr_sampling_request_b);
-					}
-					else
-					{
-						uart_write_bytes(UART_NUM, B_BUSY, strlen(B_BUSY));
-					}
-				}
-				// A SEND
-				else if (memcmp(enqueued_message.msg_ptr, A_SEND, (strlen(A_SEND))) == 0)
-				{
-					if (data_ready_a)
-					{
-						
-						if (fft_ready_a)
-						{
-							uart_write_bytes(UART_NUM, A_OK, strlen(A_OK));
-							xTaskNotifyGive(handl_uart_fft_components);
-						}
-						else if (xQueueSend(queue_fft_calculation, &fft_queue_msg_a, 0) == pdTRUE)
-						{
-							uart_write_bytes(UART_NUM, A_OK, strlen(A_OK));
-							uart_write_bytes(UART_NUM, FFT, strlen(FFT));
-						}
-						else
-						{
-							uart_write_bytes(UART_NUM, FFT, strlen(FFT));
-							uart_write_bytes(UART_NUM, FAIL, strlen(FAIL));
-						}
-					}
-					else
-					{
-						uart_write_bytes(UART_NUM, A_NOTRDY, strlen(A_NOTRDY));
-					}
-				}
-				// B SEND
-				else if (memcmp(enqueued_message.msg_ptr, B_SEND, (strlen(B_SEND))) == 0)
-				{
-					if (data_ready_b)
-					{
-						if (fft_ready_b)
-						{
-							uart_write_bytes(UART_NUM, B_OK, strlen(B_OK));
-							xTaskNotifyGive(handl_uart_fft_components);
-						}
-						else if (xQueueSend(queue_fft_calculation, &fft_queue_msg_b, 0) == pdTRUE)
-						{
-							uart_write_bytes(UART_NUM, B_OK, strlen(B_OK));
-							uart_write_bytes(UART_NUM, FFT, strlen(FFT));
-						}
-						else
-						{
-							uart_write_bytes(UART_NUM, FFT, strlen(FFT));
-							uart_write_bytes(UART_NUM, FAIL, strlen(FAIL));
-						}
-					}
-					else
-					{
-						uart_write_bytes(UART_NUM, B_NOTRDY, strlen(B_NOTRDY));
-					}
-				}
-				else
-				{
-					uart_write_bytes(UART_NUM, "?>", strlen("?>"));
-					uart_write_bytes(UART_NUM, enqueued_message.msg_ptr, enqueued_message.msg_size);
-				}
-				free(enqueued_message.msg_ptr);
+				// Arguments start after the spaces that follow the name
+				const char *args = &enqueued_message.msg[command->name_len];
+				while (*args == ' ')
+					args++;
+				command->handler(command, args);
 			}
 			else
 			{
-				ESP_LOGE(TAG, "Null pointer passed");
+				// Echo the unknown command, truncated to the status payload size
+				char unknown_msg[UART_FRAME_STATUS_MAX_LEN + 1];
+				snprintf(unknown_msg, sizeof(unknown_msg), "?>%s", enqueued_message.msg);
+				uart_frame_send_status(unknown_msg);
 			}
 		}
 	}
-}
\ No newline at end of file
+}
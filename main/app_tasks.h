@@ -16,45 +16,90 @@
 #include "my_i2c_com.h"
 #include "data_structs.h"
 #include "my_fft.h"
+#include "fft_bench.h"
+#include "sampling_timer.h"
+#include "capture_buffer.h"
+#include "stream_ring.h"
+#include "goertzel_bank.h"
+#include "uart_frame.h"
 #include "uart_isr_handler.h"
 
 // Task handles
 extern TaskHandle_t handl_mpu_sampling_begin;
 extern TaskHandle_t handl_fft_calculation;
 extern TaskHandle_t handl_uart_fft_components;
-// extern TaskHandle_t handl_uart_data_samples;
+extern TaskHandle_t handl_fft_benchmark;
+extern TaskHandle_t handl_uart_data_samples;
+extern TaskHandle_t handl_uart_goertzel;
 
 // Semaphores
-extern SemaphoreHandle_t semphr_sampling_request_a;
-extern SemaphoreHandle_t semphr_sampling_request_b;
 extern SemaphoreHandle_t semphr_uart_request;
+extern SemaphoreHandle_t semphr_fft_sent;
 
 // Queueu handles for UART ISR events
 extern QueueHandle_t queue_uart_event_queue;
 extern QueueHandle_t queue_enqueued_msg_processing;
 extern QueueHandle_t queue_fft_calculation;
+extern QueueHandle_t queue_capture_start;
+extern QueueHandle_t queue_goertzel_results;
+extern QueueHandle_t queue_sampling_events;
 
 
 // Structs
 typedef struct FFTQueueMessage_type
 {
-	bool array_number;
-	float *array_ptr;
+	uint8_t capture_id;
+	captureBufferType *capture;
+	bool stream_window;	   // true: FFT of the stream window at window_start, capture is not used
+	bool published;		   // capture was PUBLISHED when the SEND claimed it, its spectrum may still be in the FFT buffers
+	uint32_t window_start; // absolute position of the stream window in stream_ring
 	
 }FFTQueueMessage_type;
 
+typedef enum sampling_event_type
+{
+	SAMPLING_EVENT_DATRDY,	 // capture_id is READY
+	SAMPLING_EVENT_OVERFLOW, // FIFO overflowed, capture_id restarted (-1 none)
+	SAMPLING_EVENT_MPU_ERROR // reading the MPU failed, all recordings stopped
+} sampling_event_type;
+
+// Status of the sampling task, formatted and sent by the message handler so the sampling task never waits for the UART
+typedef struct SamplingEvent_type
+{
+	sampling_event_type type;
+	int8_t capture_id;
+	
+}SamplingEvent_type;
+
 typedef struct TaskQueueMessage_type
 {
 	size_t msg_size;
-	uint8_t *msg_ptr;
+	char msg[UART_MSG_MAX_LEN + 1]; // '\0' terminated, carried inline so no heap is used per message
 	
 }TaskQueueMessage_type;
 
+#define MSG_CAPTURE_ID_ARG UINT32_MAX // MsgCommand_type context of capture commands that take the capture id as first argument
+
+typedef struct MsgCommand_type
+{
+	const char *name;
+	size_t name_len;
+	void (*handler)(const struct MsgCommand_type *command, const char *args); // args: '\0' terminated, leading spaces skipped
+	uint32_t context; // handler specific, e.g. 0 = A / 1 = B
+	
+}MsgCommand_type;
+
 
-extern float *data_samples_a;
-extern float *data_samples_b;
+extern captureBufferType capture_pool[CAPTURE_POOL_SIZE];
+extern uint32_t capture_n_samples;
+extern streamRingType stream_ring;
+extern goertzelBankType goertzel_bank;
 extern indexed_float_type *indexed_magnitudes;
+extern float *fft_power_arr;
 extern float *fft_complex_arr;
+extern fftResultInfoType fft_result_info;
+extern fftPeakListType fft_peak_list;
+extern uartRxParserType uart_rx_parser;
 
 
 void task_initialization(void *params);
@@ -62,6 +107,8 @@ void task_mpu6050_data_sampling(void *params);
 void task_fft_calculation(void *params);
 void task_uart_fft_components(void *params);
 void task_uart_data_samples(void *params);
+void task_uart_goertzel(void *params);
+void task_fft_benchmark(void *params);
 
 // UART ISR MONITORING
 void task_uart_isr_monitoring(void *);
@@ -0,0 +1,244 @@
+#include "capture_buffer.h"
+
+/**
+ * @brief Allocate the sample arrays of a capture buffer and select the default channels
+ *
+ * CAPTURE_MAX_CHANNELS arrays of N_SAMPLES raw counts are allocated in PSRAM once at startup,
+ * so changing the channel mask between captures never allocates.
+ *
+ * @param capture capture buffer to initialize
+ * @return 0 OK
+ * @return -1 NULL pointer passed
+ * @return -2 failed to allocate sample arrays
+ */
+int capture_buffer_init(captureBufferType *capture)
+{
+    if (capture == NULL)
+    {
+        return -1;
+    }
+    memset(capture, 0, sizeof(captureBufferType));
+    capture_state_init(&capture->state);
+
+    for (int slot = 0; slot < CAPTURE_MAX_CHANNELS; slot++)
+    {
+        capture->samples[slot] = (int16_t *)heap_caps_malloc(N_SAMPLES * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+        if (capture->samples[slot] == NULL)
+        {
+            for (int i = 0; i < slot; i++)
+            {
+                heap_caps_free(capture->samples[i]);
+                capture->samples[i] = NULL;
+            }
+            return -2;
+        }
+    }
+    capture->n_samples = N_SAMPLES;
+    return capture_buffer_set_channels(capture, CAPTURE_DEFAULT_CHANNELS, NULL);
+}
+
+/**
+ * @brief Check if a capture length can be recorded into a capture buffer
+ *
+ * @param n_samples samples per channel
+ * @return 0 OK
+ * @return -2 not a power of 2 or outside CAPTURE_MIN_SAMPLES..N_SAMPLES
+ */
+int capture_buffer_check_length(uint32_t n_samples)
+{
+    if (n_samples < CAPTURE_MIN_SAMPLES || n_samples > N_SAMPLES || (n_samples & (n_samples - 1)) != 0)
+    {
+        return -2;
+    }
+    return 0;
+}
+
+/**
+ * @brief Select the number of samples per channel of the next capture
+ *
+ * Must not be called while the buffer is sampling. The sample arrays are allocated for N_SAMPLES,
+ * a shorter capture only uses the start of them.
+ *
+ * @param capture capture buffer
+ * @param n_samples samples per channel (power of 2, CAPTURE_MIN_SAMPLES..N_SAMPLES)
+ * @return 0 OK
+ * @return -1 NULL pointer passed
+ * @return -2 invalid length
+ */
+int capture_buffer_set_length(captureBufferType *capture, uint32_t n_samples)
+{
+    if (capture == NULL)
+    {
+        return -1;
+    }
+    int error_code = capture_buffer_check_length(n_samples);
+    if (error_code != 0)
+    {
+        return error_code;
+    }
+    capture->n_samples = n_samples;
+    return 0;
+}
+
+/**
+ * @brief Check if a channel mask can be recorded into a capture buffer
+ *
+ * @param channel_mask CAPTURE_CH_* mask of the channels to record
+ * @return 0 OK
+ * @return -2 empty mask or channels not available in the current sampling mode
+ * @return -3 more channels than CAPTURE_MAX_CHANNELS
+ */
+int capture_buffer_check_channels(uint8_t channel_mask)
+{
+    if (channel_mask == 0 || (channel_mask & ~CAPTURE_AVAILABLE_CHANNELS) != 0)
+    {
+        return -2;
+    }
+    int n_channels = 0;
+    for (uint8_t channel = 0; channel < CAPTURE_N_CHANNELS; channel++)
+    {
+        if (channel_mask & (1 << channel))
+            n_channels++;
+    }
+    if (n_channels > CAPTURE_MAX_CHANNELS)
+    {
+        return -3;
+    }
+    return 0;
+}
+
+/**
+ * @brief Select the channels recorded into a capture buffer and latch their bias and scale
+ *
+ * Must not be called while the buffer is sampling. The current calibration errors are stored
+ * with the capture, so a later calibration does not change the meaning of the recorded counts.
+ *
+ * @param capture capture buffer
+ * @param channel_mask CAPTURE_CH_* mask of the channels to record
+ * @param mpu_data_t struct with avg_err used as bias (NULL for zero bias)
+ * @return 0 OK
+ * @return -1 NULL pointer passed
+ * @return -2 empty mask or channels not available in the current sampling mode
+ * @return -3 more channels than CAPTURE_MAX_CHANNELS
+ */
+int capture_buffer_set_channels(captureBufferType *capture, uint8_t channel_mask, const mpuDataType *mpu_data_t)
+{
+    if (capture == NULL)
+    {
+        return -1;
+    }
+    int error_code = capture_buffer_check_channels(channel_mask);
+    if (error_code != 0)
+    {
+        return error_code;
+    }
+
+    uint8_t n_channels = 0;
+    for (uint8_t channel = 0; channel < CAPTURE_N_CHANNELS; channel++)
+    {
+        if ((channel_mask & (1 << channel)) == 0)
+            continue;
+        capture->channels[n_channels] = channel;
+        capture->bias[n_channels] = (mpu_data_t != NULL) ? mpu_data_t->avg_err[channel] : 0.0f;
+        capture->scale[n_channels] = (channel < 3) ? (1.0f / MPU_ACCEL_FS) : (1.0f / MPU_GYRO_FS);
+        n_channels++;
+    }
+    capture->n_channels = n_channels;
+    capture->channel_mask = channel_mask;
+    return 0;
+}
+
+/**
+ * @brief Store the raw channels of one sample into the capture buffer
+ *
+ * @param capture capture buffer
+ * @param index sample index (< capture->n_samples)
+ * @param mpu_data_t struct with accel_gyro_raw of the current sample
+ */
+void capture_buffer_store_sample(captureBufferType *capture, size_t index, const mpuDataType *mpu_data_t)
+{
+    for (int slot = 0; slot < capture->n_channels; slot++)
+    {
+        capture->samples[slot][index] = mpu_data_t->accel_gyro_raw[capture->channels[slot]];
+    }
+}
+
+/**
+ * @brief Convert one recorded sample to physical units
+ *
+ * @param capture capture buffer
+ * @param slot channel slot (< n_channels)
+ * @param index sample index (< capture->n_samples)
+ * @return sample in g or deg/s
+ */
+float capture_buffer_get_sample(const captureBufferType *capture, int slot, size_t index)
+{
+    return ((float)capture->samples[slot][index] - capture->bias[slot]) * capture->scale[slot];
+}
+
+/**
+ * @brief Encode a chunk of raw counts of one slot as a RAW_SAMPLES or RAW_SAMPLES_RICE payload
+ *
+ * Payload layout (little endian):
+ * u8 source | u8 channel | u16 count | u32 sample_rate_hz | u32 n_samples | u32 offset | f32 bias | f32 scale | counts
+ * counts are i16 counts[count], or a data_codec_encode_rice block if compressed.
+ * The host converts a count with value = (count - bias) * scale.
+ *
+ * @param capture capture buffer
+ * @param slot channel slot (< n_channels)
+ * @param source fft_source_type of the capture buffer
+ * @param offset index of the first sample of the chunk
+ * @param count number of samples in the chunk (offset + count <= capture->n_samples)
+ * @param compressed Rice code the counts
+ * @param payload_buffer buffer that receives the payload
+ * @param payload_size size of payload_buffer
+ * @return >0 length of the payload
+ * @return -1 NULL pointer passed or invalid slot
+ * @return -2 chunk out of range
+ * @return -3 payload buffer too small (compressed: the chunk did not compress below the raw size)
+ */
+int capture_buffer_encode_chunk(const captureBufferType *capture, int slot, uint8_t source, size_t offset, size_t count, bool compressed, uint8_t *payload_buffer, size_t payload_size)
+{
+    if (capture == NULL || payload_buffer == NULL || slot < 0 || slot >= capture->n_channels)
+    {
+        return -1;
+    }
+    if (offset > capture->n_samples || count > capture->n_samples - offset || count > UINT16_MAX)
+    {
+        return -2;
+    }
+    // A compressed chunk may not be longer than the raw one, the caller falls back to raw counts
+    if (payload_size > RAW_DUMP_HEADER_SIZE + count * sizeof(int16_t))
+    {
+        payload_size = RAW_DUMP_HEADER_SIZE + count * sizeof(int16_t);
+    }
+    else if (payload_size < RAW_DUMP_HEADER_SIZE + count * sizeof(int16_t))
+    {
+        return -3;
+    }
+
+    uint16_t count_u16 = (uint16_t)count;
+    uint32_t sample_rate_hz = MPU_SAMPLING_RATE_HZ;
+    uint32_t n_samples = capture->n_samples;
+    uint32_t offset_u32 = (uint32_t)offset;
+
+    payload_buffer[0] = source;
+    payload_buffer[1] = capture->channels[slot];
+    memcpy(&payload_buffer[2], &count_u16, sizeof(uint16_t));
+    memcpy(&payload_buffer[4], &sample_rate_hz, sizeof(uint32_t));
+    memcpy(&payload_buffer[8], &n_samples, sizeof(uint32_t));
+    memcpy(&payload_buffer[12], &offset_u32, sizeof(uint32_t));
+    memcpy(&payload_buffer[16], &capture->bias[slot], sizeof(float));
+    memcpy(&payload_buffer[20], &capture->scale[slot], sizeof(float));
+    if (compressed)
+    {
+        int block_len = data_codec_encode_rice(&payload_buffer[RAW_DUMP_HEADER_SIZE], payload_size - RAW_DUMP_HEADER_SIZE, &capture->samples[slot][offset], count);
+        if (block_len < 0)
+        {
+            return -3;
+        }
+        return RAW_DUMP_HEADER_SIZE + block_len;
+    }
+    memcpy(&payload_buffer[RAW_DUMP_HEADER_SIZE], &capture->samples[slot][offset], count * sizeof(int16_t));
+    return (int)(RAW_DUMP_HEADER_SIZE + count * sizeof(int16_t));
+}
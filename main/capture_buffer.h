@@ -0,0 +1,21 @@
+#ifndef CAPTURE_BUFFER_H
+#define CAPTURE_BUFFER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "constants.h"
+#include "data_structs.h"
+#include "data_codec.h"
+
+int capture_buffer_init(captureBufferType *capture);
+int capture_buffer_check_channels(uint8_t channel_mask);
+int capture_buffer_set_channels(captureBufferType *capture, uint8_t channel_mask, const mpuDataType *mpu_data_t);
+int capture_buffer_check_length(uint32_t n_samples);
+int capture_buffer_set_length(captureBufferType *capture, uint32_t n_samples);
+void capture_buffer_store_sample(captureBufferType *capture, size_t index, const mpuDataType *mpu_data_t);
+float capture_buffer_get_sample(const captureBufferType *capture, int slot, size_t index);
+int capture_buffer_encode_chunk(const captureBufferType *capture, int slot, uint8_t source, size_t offset, size_t count, bool compressed, uint8_t *payload_buffer, size_t payload_size);
+
+#endif // CAPTURE_BUFFER_H
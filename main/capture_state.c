@@ -0,0 +1,68 @@
+#include "capture_state.h"
+
+/**
+ * @brief Set a capture buffer state to FREE
+ *
+ * Must be called before the state is shared between tasks.
+ *
+ * @param state capture buffer state
+ */
+void capture_state_init(captureStateType *state)
+{
+    atomic_init(state, CAPTURE_STATE_FREE);
+}
+
+/**
+ * @brief Read the current state
+ *
+ * @param state capture buffer state
+ * @return current state, may change right after the call unless the caller owns the buffer
+ */
+capture_state_type capture_state_get(captureStateType *state)
+{
+    return (capture_state_type)atomic_load(state);
+}
+
+/**
+ * @brief Move a buffer from one state to another if it is still in the expected state
+ *
+ * @param state capture buffer state
+ * @param from expected current state
+ * @param to new state
+ * @return true if the transition was made
+ */
+bool capture_state_transition(captureStateType *state, capture_state_type from, capture_state_type to)
+{
+    unsigned int expected = from;
+    return atomic_compare_exchange_strong(state, &expected, to);
+}
+
+/**
+ * @brief Move a buffer to a new state from any state of a set
+ *
+ * Compare and swap loop: the state is only changed if it is still the one that was checked,
+ * so of two tasks claiming the same buffer exactly one succeeds.
+ *
+ * @param state capture buffer state
+ * @param from_mask CAPTURE_STATE_BIT mask of the states the buffer may be claimed from
+ * @param to new state
+ * @param previous state before the transition (may be NULL), or the current state if the claim failed
+ * @return true if the transition was made
+ */
+bool capture_state_claim(captureStateType *state, uint32_t from_mask, capture_state_type to, capture_state_type *previous)
+{
+    unsigned int current = atomic_load(state);
+
+    while (CAPTURE_STATE_BIT(current) & from_mask)
+    {
+        if (atomic_compare_exchange_weak(state, &current, to))
+        {
+            if (previous != NULL)
+                *previous = (capture_state_type)current;
+            return true;
+        }
+    }
+    if (previous != NULL)
+        *previous = (capture_state_type)current;
+    return false;
+}
@@ -0,0 +1,39 @@
+#ifndef CAPTURE_STATE_H
+#define CAPTURE_STATE_H
+
+// Portable ownership state of a capture buffer (C11 atomics, no ESP-IDF dependencies, also built by host tools)
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/**
+ * @brief Owner of a capture buffer
+ *
+ * FREE -> (QUEUED ->) SAMPLING -> READY -> PROCESSING -> PUBLISHED. A task owns the buffer while it is PROCESSING
+ * (FFT, raw dump, benchmark copy or a START configuring it) and hands it on with the next transition.
+ * START may claim a buffer that is FREE, READY or PUBLISHED, never one that is queued, sampling or processing.
+ */
+typedef enum capture_state_type
+{
+    CAPTURE_STATE_FREE,       // no valid samples
+    CAPTURE_STATE_SAMPLING,   // written by the sampling task
+    CAPTURE_STATE_READY,      // complete capture, spectrum not sent yet
+    CAPTURE_STATE_PROCESSING, // owned by one task, the samples do not change
+    CAPTURE_STATE_PUBLISHED,  // complete capture, spectrum sent
+    CAPTURE_STATE_QUEUED,     // configured, recorded by the sampling task after the captures started before it
+} capture_state_type;
+
+#define CAPTURE_STATE_BIT(state) (1u << (state))
+#define CAPTURE_STATES_COMPLETE (CAPTURE_STATE_BIT(CAPTURE_STATE_READY) | CAPTURE_STATE_BIT(CAPTURE_STATE_PUBLISHED))
+#define CAPTURE_STATES_IDLE (CAPTURE_STATE_BIT(CAPTURE_STATE_FREE) | CAPTURE_STATES_COMPLETE)
+
+typedef atomic_uint captureStateType;
+
+void capture_state_init(captureStateType *state);
+capture_state_type capture_state_get(captureStateType *state);
+bool capture_state_transition(captureStateType *state, capture_state_type from, capture_state_type to);
+bool capture_state_claim(captureStateType *state, uint32_t from_mask, capture_state_type to, capture_state_type *previous);
+
+#endif // CAPTURE_STATE_H
@@ -10,16 +10,37 @@
 #define TASK_MPU_SAMPLING_STACK_SIZE (512 * 5)
 #define TASK_FFT_CALC_STACK_SIZE (512 * 5)
 #define TASK_SEND_FFT_STACK_SIZE (512 * 5)
-// #define TASK_SEND_DATA_SAMPLES_STACK_SIZE (512 * 5) // Task is only used for debugging
+#define TASK_SEND_DATA_SAMPLES_STACK_SIZE (512 * 5)
 #define TASK_ISRUART_STACK_SIZE (1024 * 4)
 #define TASK_MSG_Q_STACK_SIZE (512 * 4)
+#define TASK_FFT_BENCH_STACK_SIZE (1024 * 4)
+#define TASK_FFT_WORKER_STACK_SIZE (512 * 4)
+#define TASK_SEND_GOERTZEL_STACK_SIZE (512 * 4)
 #define DEBUG_STACKS 0
 
 #define N_SAMPLES_32 32768					// set N_SAMPLES size
 #define N_SAMPLES_16 16384					// set N_SAMPLES size
 #define N_SAMPLES N_SAMPLES_32				// Number of samples taken for analysis
-#define FFT_COMPONENTS_SIZE (N_SAMPLES * 2) // Size of fft complex components array size
+#define FFT_REAL_INPUT 1					// 1: pack N real samples as N/2 complex points and run a half size FFT, 0: full size complex FFT
+#if FFT_REAL_INPUT == 1
+#define FFT_COMPONENTS_LEN(n) (n)			// Number of floats in the fft complex array for n samples (n/2 re, im pairs)
+#else
+#define FFT_COMPONENTS_LEN(n) ((n) * 2)		// Number of floats in the fft complex array for n samples (n re, im pairs)
+#endif
+#define FFT_COMPONENTS_SIZE FFT_COMPONENTS_LEN(N_SAMPLES) // Size of fft complex components array size
 #define MAGNITUDES_SIZE (N_SAMPLES / 2)		// size of magnitudes struct array size
+#define FFT_MS_PERCENTILE 99				// Percentile of magnitudes that are sent as most significant components
+#define FFT_DEFAULT_WINDOW FFT_WINDOW_HANN	// fft_window_type applied to every spectrum until changed with "FFT WIN"
+#define FFT_MS_MAX_COMPONENTS (MAGNITUDES_SIZE - (MAGNITUDES_SIZE * FFT_MS_PERCENTILE) / 100) // Upper bound of fft_percentile_n_components
+#define FFT_BENCH_ITERATIONS 5				// Number of timed runs of the FFT chain per benchmarked signal
+#define FFT_BACKEND_AUTOSELECT 1			// 1: verify and time every FFT backend in fft_init and keep the fastest, 0: use esp-dsp radix-2
+#define FFT_BACKEND_BENCH_RUNS 3			// Timed transforms per backend at boot
+#define FFT_BACKEND_TOLERANCE 1e-4f			// Max error of a backend relative to the peak of the reference result
+#define FFT_DUAL_CORE 1						// 1: split large transforms between both cores (worker task pinned to core 1), 0: one core
+#define FFT_DUAL_CORE_MIN_POINTS 2048		// Smaller transforms stay on one core, the split overhead outweighs the gain
+#define FFT_PEAK_MAX_PEAKS 32				// Strongest peaks sent per spectrum with "FFT PEAKS"
+#define FFT_PEAK_FLOOR_BLOCK 64				// Bins per noise floor estimate (median power of the block)
+#define FFT_PEAK_THRESHOLD_DB 12.0f			// Min height of a peak above the noise floor of its block
 
 // I2C CONFIGURATION
 #define I2C_SCL_IO CONFIG_I2C_MASTER_SCL // GPIO number used for I2C master clock
@@ -41,6 +62,7 @@
 #define MPU_PWR_REG 0x6B		 // Reg adr - wake up the MPU6050
 #define MPU_USER_CTRL_REG 0x6A	 // Reg adr - FIFO buffer enable, reset (and more)
 #define MPU_FIFO_EN_REG 0x23	 // Reg adr - config which data is stored in FIFO buffer
+#define MPU_SMPLRT_DIV_REG 0x19	 // Reg adr - sample rate divider
 #define MPU_GYRO_CFG_REG 0x1B	 // Reg adr - gyro full scale configuration
 #define MPU_ACCEL_CFG_REG 0x1C	 // Reg adr - accel configuration
 
@@ -55,6 +77,12 @@
 
 // MPU SETTING MASKS
 #define MPU_FIFO_EN_MASK 0x78	 // Reg mask - use with MPU_FIFO_EN_REG; Enable gyro and acel in FIFO)
+#define MPU_FIFO_EN_TEMP 0x80	 // Reg mask - use with MPU_FIFO_EN_REG; temperature in FIFO (2 bytes per frame)
+#define MPU_FIFO_EN_GYRO_X 0x40	 // Reg mask - use with MPU_FIFO_EN_REG; gyro X in FIFO (2 bytes per frame)
+#define MPU_FIFO_EN_GYRO_Y 0x20	 // Reg mask - use with MPU_FIFO_EN_REG; gyro Y in FIFO (2 bytes per frame)
+#define MPU_FIFO_EN_GYRO_Z 0x10	 // Reg mask - use with MPU_FIFO_EN_REG; gyro Z in FIFO (2 bytes per frame)
+#define MPU_FIFO_EN_ACCEL 0x08	 // Reg mask - use with MPU_FIFO_EN_REG; accel X, Y, Z in FIFO (6 bytes per frame)
+#define MPU_FIFO_OVERFLOW_MASK 0x10 // Reg mask - use with MPU_FIFO_OVERFLOW; FIFO overflow interrupt bit
 #define MPU_FIFO_RESET_MASK 0x44 // Reg mask - use with MPU_USER_CTRL_REG; Reset FIFO and keep it enabled: 0x04 - fifo reset; 0x40 - fifo enable)
 #define MPU_FIFO_DISSABLE 0044	 // Reg mask - use with MPU_USER_CTRL_REG; Reset FIFO and keep it dissabled: 0x04 - fifo reset; 0x40 - fifo enable)
 
@@ -102,6 +130,149 @@
 #define MPU_FILTER_FREQ_MASK MPU_FILTER_DISSABLED
 #endif
 
+/**
+ * @brief SAMPLING RATE SETTINGS
+ * @attention Uncomment one of the sampling rate settings
+ *
+ * Samples are paced by a hardware timer (gptimer), so the rate is not limited by the FreeRTOS tick.
+ * The MPU sample rate divider is set to the same rate. Gyro output rate is 8 kHz with the DLPF
+ * disabled (or at 260 Hz) and 1 kHz otherwise. The accelerometer output rate is 1 kHz according to
+ * the datasheet, above that the accel registers hold the same value for several samples.
+ * Default is 1 kHz.
+ */
+// #define MPU_SAMPLING_RATE_2kHz
+// #define MPU_SAMPLING_RATE_4kHz
+// #define MPU_SAMPLING_RATE_8kHz
+
+#if defined(MPU_SAMPLING_RATE_2kHz)
+#define MPU_SAMPLING_RATE_HZ 2000
+#elif defined(MPU_SAMPLING_RATE_4kHz)
+#define MPU_SAMPLING_RATE_HZ 4000
+#elif defined(MPU_SAMPLING_RATE_8kHz)
+#define MPU_SAMPLING_RATE_HZ 8000
+#else
+#define MPU_SAMPLING_RATE_HZ 1000
+#endif
+
+#if (MPU_FILTER_FREQ_MASK == MPU_FILTER_DISSABLED) || (MPU_FILTER_FREQ_MASK == MPU_FILTER_FREQ_MASK_260Hz)
+#define MPU_GYRO_OUTPUT_RATE_HZ 8000 // Gyro output rate with DLPF disabled
+#else
+#define MPU_GYRO_OUTPUT_RATE_HZ 1000 // Gyro output rate with DLPF enabled
+#endif
+
+#if MPU_SAMPLING_RATE_HZ > MPU_GYRO_OUTPUT_RATE_HZ
+#error "MPU_SAMPLING_RATE_HZ above 1 kHz requires the DLPF to be disabled"
+#endif
+
+// Sample rate = gyro output rate / (1 + MPU_SMPLRT_DIV)
+#define MPU_SMPLRT_DIV ((MPU_GYRO_OUTPUT_RATE_HZ / MPU_SAMPLING_RATE_HZ) - 1)
+
+/**
+ * @brief FIFO SAMPLING SETTINGS
+ *
+ * With MPU_SAMPLING_FIFO the MPU writes samples into its FIFO at MPU_SAMPLING_RATE_HZ and the
+ * sampling task drains whole frames in one burst read every MPU_FIFO_DRAIN_FRAMES samples.
+ * FIFO frame content is set by MPU_FIFO_SAMPLING_EN_MASK (accel + gyro = 12 bytes per frame). Every frame holds every
+ * channel a capture, the stream or the Goertzel bank may select, so a new channel mask never restarts the FIFO.
+ */
+#define MPU_SAMPLING_FIFO 0							// 1: drain samples from the MPU FIFO, 0: read data registers on every timer tick
+#define MPU_FIFO_SAMPLING_EN_MASK (MPU_FIFO_EN_ACCEL | MPU_FIFO_EN_GYRO_X | MPU_FIFO_EN_GYRO_Y | MPU_FIFO_EN_GYRO_Z) // Data stored in FIFO while sampling
+#define MPU_FIFO_MAX_BYTES 1024						// MPU6050 FIFO buffer size
+#define MPU_FIFO_DRAIN_FRAMES 8						// Frames expected per drain (sets the drain timer period)
+#if MPU_SAMPLING_FIFO == 1
+#define SAMPLING_TIMER_RATE_HZ (MPU_SAMPLING_RATE_HZ / MPU_FIFO_DRAIN_FRAMES) // Timer drains the FIFO
+#else
+#define SAMPLING_TIMER_RATE_HZ MPU_SAMPLING_RATE_HZ // Timer triggers every register read
+#endif
+
+/**
+ * @brief CAPTURE CHANNEL SETTINGS
+ *
+ * Bit i of a capture channel mask selects mpu_data_t.accel_gyro_raw[i]. Every selected channel is
+ * stored as raw int16 counts into its own contiguous N_SAMPLES array, all channels of a capture come from the same reads.
+ * Host selects channels with an optional hex mask after the start command, e.g. "A START 07".
+ */
+#define CAPTURE_CH_ACCEL_X 0x01
+#define CAPTURE_CH_ACCEL_Y 0x02
+#define CAPTURE_CH_ACCEL_Z 0x04
+#define CAPTURE_CH_GYRO_X 0x08
+#define CAPTURE_CH_GYRO_Y 0x10
+#define CAPTURE_CH_GYRO_Z 0x20
+#define CAPTURE_CH_ACCEL_MASK 0x07 // Channels available from the 6 byte accel read
+#define CAPTURE_CH_GYRO_MASK 0x38  // Channels that need the 14 byte accel + temp + gyro read
+#define CAPTURE_N_CHANNELS 6
+#define CAPTURE_MAX_CHANNELS 3						   // Sample arrays allocated per capture buffer (N_SAMPLES int16 raw counts each, PSRAM)
+#define CAPTURE_DEFAULT_CHANNELS CAPTURE_CH_ACCEL_X // Channels recorded when start command has no mask
+#define CAPTURE_MIN_SAMPLES 1024					   // Shortest capture length selectable with "N <value>", N_SAMPLES is the longest
+#define CAPTURE_POOL_SIZE 4							   // Capture buffers, ids 0..CAPTURE_POOL_SIZE-1 (letters A, B, C, ...)
+#if MPU_SAMPLING_FIFO == 1
+// Only channels stored in the FIFO frame can be captured
+#define CAPTURE_AVAILABLE_CHANNELS (((MPU_FIFO_SAMPLING_EN_MASK & MPU_FIFO_EN_ACCEL) ? CAPTURE_CH_ACCEL_MASK : 0) | \
+									((MPU_FIFO_SAMPLING_EN_MASK & MPU_FIFO_EN_GYRO_X) ? CAPTURE_CH_GYRO_X : 0) |     \
+									((MPU_FIFO_SAMPLING_EN_MASK & MPU_FIFO_EN_GYRO_Y) ? CAPTURE_CH_GYRO_Y : 0) |     \
+									((MPU_FIFO_SAMPLING_EN_MASK & MPU_FIFO_EN_GYRO_Z) ? CAPTURE_CH_GYRO_Z : 0))
+#else
+#define CAPTURE_AVAILABLE_CHANNELS (CAPTURE_CH_ACCEL_MASK | CAPTURE_CH_GYRO_MASK)
+#endif
+
+/**
+ * @brief STREAMING STFT SETTINGS
+ *
+ * "STREAM START" records one channel continuously into a ring buffer. Every STREAM_HOP_SIZE samples
+ * the last STREAM_WINDOW_SIZE samples are transformed and sent ("S FFTRDY" + FFT components).
+ * The ring holds two hops more than a window, that is the time the FFT task has to copy a completed window.
+ */
+#define STREAM_WINDOW_SIZE 4096										// Samples per STFT window (power of 2, <= N_SAMPLES)
+#define STREAM_HOP_SIZE (STREAM_WINDOW_SIZE / 2)					// Samples between window starts (50 % overlap)
+#define STREAM_RING_SIZE (STREAM_WINDOW_SIZE + 2 * STREAM_HOP_SIZE) // Ring buffer length in samples
+#if STREAM_WINDOW_SIZE > N_SAMPLES || STREAM_HOP_SIZE > STREAM_WINDOW_SIZE
+#error "STREAM_WINDOW_SIZE must be <= N_SAMPLES and STREAM_HOP_SIZE <= STREAM_WINDOW_SIZE"
+#endif
+
+/**
+ * @brief GOERTZEL FILTER BANK SETTINGS
+ *
+ * "GOERTZEL <mask> <f1> [f2 ...]" tracks up to GOERTZEL_MAX_FREQS frequencies (Hz) of one channel
+ * continuously, the amplitudes are sent as a GOERTZEL frame every GOERTZEL_BLOCK_SIZE samples.
+ */
+#define GOERTZEL_MAX_FREQS 12	   // Frequencies per bank
+#define GOERTZEL_BLOCK_SIZE 1024   // Samples per reported block (resolution about MPU_SAMPLING_RATE_HZ / GOERTZEL_BLOCK_SIZE)
+#define GOERTZEL_QUEUE_LEN 2	   // Completed blocks waiting for the sender
+
+/**
+ * @brief UART FRAME PROTOCOL
+ *
+ * Every output is sent as one frame (little endian):
+ * magic (2) | version (1) | type (1) | sequence (2) | payload length (4) | payload | CRC32 (4)
+ * CRC32 (esp_rom_crc32_le, init 0) covers version .. end of payload.
+ */
+#define UART_FRAME_MAGIC_0 0xA5
+#define UART_FRAME_MAGIC_1 0x5A
+#define UART_FRAME_VERSION 1
+#define UART_FRAME_HEADER_SIZE 10
+#define UART_FRAME_CRC_SIZE 4
+#define UART_FRAME_OVERHEAD (UART_FRAME_HEADER_SIZE + UART_FRAME_CRC_SIZE)
+#define UART_FRAME_STATUS_MAX_LEN 64 // Longest status text payload
+#define UART_MSG_MAX_LEN 128 // Longest received command, carried inline in the message queue items
+#define MSG_QUEUE_LEN 4 // Received commands waiting for the message handler
+#define SAMPLING_EVENT_QUEUE_LEN 8 // Sampling task status events waiting for the message handler (DATRDY, OVF, MPU ERR)
+#define UART_RX_CHUNK_SIZE 128 // Bytes read from the UART driver per parser call
+#define ENCAP_START_PAT "++*" // Received commands are framed as "++*" MESSAGE "*++"
+#define ENCAP_END_PAT "*++"
+#define ENCAP_FLAG_SIZE (sizeof(ENCAP_START_PAT) - 1)
+#define FFT_FRAME_METADATA_SIZE 16	 // n_samples, n_components, sample rate, source, channel, reserved
+#define FFT_FRAME_SIZE(n_components) (UART_FRAME_OVERHEAD + FFT_FRAME_METADATA_SIZE + (n_components) * (sizeof(uint32_t) + 2 * sizeof(float))) // FFT components frame
+#define RAW_DUMP_CHUNK_SAMPLES 2048	 // Raw counts per RAW_SAMPLES frame
+#define RAW_DUMP_HEADER_SIZE 24		 // source, channel, count, sample rate, n_samples, offset, bias, scale
+#define RAW_DUMP_FRAME_SIZE (UART_FRAME_OVERHEAD + RAW_DUMP_HEADER_SIZE + RAW_DUMP_CHUNK_SAMPLES * sizeof(int16_t))
+#define FFT_PEAKS_FRAME_SIZE (UART_FRAME_OVERHEAD + FFT_FRAME_METADATA_SIZE + sizeof(float) + FFT_PEAK_MAX_PEAKS * 2 * sizeof(float))
+#define GOERTZEL_HEADER_SIZE 16		 // channel, n_freqs, reserved, sample rate, block size, block index
+#define GOERTZEL_FRAME_SIZE (UART_FRAME_OVERHEAD + GOERTZEL_HEADER_SIZE + GOERTZEL_MAX_FREQS * 2 * sizeof(float))
+
+// Sampling timer
+#define SAMPLING_TIMER_RESOLUTION_HZ 1000000 // 1 tick = 1 us
+#define SAMPLING_TIMER_TIMEOUT_MS 100		 // Max wait for a sampling timer tick before reporting an error
+
 // ---------- ACCELEROMETER FULL SCALE SETTINGS ----------
 /**
  * @brief ACCEL FULL SCALE SETTINGS
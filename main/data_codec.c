@@ -0,0 +1,408 @@
+#include "data_codec.h"
+
+/**
+ * @brief Write an unsigned LEB128 varint (7 bits per byte, MSB set on all but the last byte)
+ *
+ * @param dst buffer with at least DATA_CODEC_VARINT_MAX_SIZE free bytes
+ * @param value value to encode
+ * @return number of bytes written (1..5)
+ */
+size_t data_codec_varint_encode(uint8_t *dst, uint32_t value)
+{
+    size_t len = 0;
+    while (value >= 0x80)
+    {
+        dst[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    dst[len++] = (uint8_t)value;
+    return len;
+}
+
+/**
+ * @brief Read an unsigned LEB128 varint
+ *
+ * @param src encoded bytes
+ * @param src_len number of readable bytes
+ * @param value decoded value
+ * @return >0 number of bytes consumed
+ * @return -1 truncated or longer than DATA_CODEC_VARINT_MAX_SIZE
+ */
+int data_codec_varint_decode(const uint8_t *src, size_t src_len, uint32_t *value)
+{
+    uint32_t result = 0;
+    for (size_t i = 0; i < src_len && i < DATA_CODEC_VARINT_MAX_SIZE; i++)
+    {
+        result |= (uint32_t)(src[i] & 0x7F) << (7 * i);
+        if ((src[i] & 0x80) == 0)
+        {
+            *value = result;
+            return (int)(i + 1);
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Pack spectrum bins into delta coded indices and int16 re, im with one scale
+ *
+ * Layout (little endian): f32 scale | varint index deltas[n_bins] | i16 re, im pairs[n_bins]
+ * The first delta is the first index, value = q * scale. The largest |re| or |im| is quantised
+ * to 32767, so the error of every component is at most scale / 2.
+ *
+ * @param dst buffer that receives the packed spectrum
+ * @param dst_size size of dst (DATA_CODEC_SPECTRUM_MAX_SIZE(n_bins) always fits)
+ * @param indices bin indices in strictly ascending order
+ * @param re_im re, im pairs of the bins (2 * n_bins floats)
+ * @param n_bins number of bins
+ * @return >0 length of the packed spectrum
+ * @return -1 NULL pointers passed
+ * @return -2 dst too small
+ * @return -3 indices not strictly ascending
+ */
+int data_codec_encode_spectrum(uint8_t *dst, size_t dst_size, const uint32_t *indices, const float *re_im, uint32_t n_bins)
+{
+    if (dst == NULL || (n_bins > 0 && (indices == NULL || re_im == NULL)))
+    {
+        return -1;
+    }
+    size_t values_size = (size_t)n_bins * 2 * sizeof(int16_t);
+    if (dst_size < sizeof(float) + values_size)
+    {
+        return -2;
+    }
+
+    float max_abs = 0.0f;
+    for (uint32_t i = 0; i < 2 * n_bins; i++)
+    {
+        float v = fabsf(re_im[i]);
+        if (v > max_abs)
+            max_abs = v;
+    }
+    float scale = (max_abs > 0.0f) ? (max_abs / 32767.0f) : 1.0f;
+    float inv_scale = 1.0f / scale;
+    memcpy(dst, &scale, sizeof(float));
+    size_t pos = sizeof(float);
+
+    // Index deltas
+    uint32_t previous = 0;
+    for (uint32_t i = 0; i < n_bins; i++)
+    {
+        if (i > 0 && indices[i] <= previous)
+        {
+            return -3;
+        }
+        if (dst_size - pos < values_size + DATA_CODEC_VARINT_MAX_SIZE)
+        {
+            return -2;
+        }
+        pos += data_codec_varint_encode(&dst[pos], indices[i] - previous);
+        previous = indices[i];
+    }
+
+    // Quantised re, im pairs
+    for (uint32_t i = 0; i < 2 * n_bins; i++)
+    {
+        long q = lrintf(re_im[i] * inv_scale);
+        if (q > 32767)
+            q = 32767;
+        else if (q < -32767)
+            q = -32767;
+        int16_t q16 = (int16_t)q;
+        memcpy(&dst[pos], &q16, sizeof(int16_t));
+        pos += sizeof(int16_t);
+    }
+    return (int)pos;
+}
+
+/**
+ * @brief Unpack a spectrum of data_codec_encode_spectrum back to indices and float re, im pairs
+ *
+ * @param src packed spectrum
+ * @param src_len length of the packed spectrum
+ * @param indices receives n_bins indices
+ * @param re_im receives 2 * n_bins floats
+ * @param n_bins number of bins (sent in the frame metadata)
+ * @return >0 number of bytes consumed
+ * @return -1 NULL pointers passed
+ * @return -2 packed spectrum truncated
+ */
+int data_codec_decode_spectrum(const uint8_t *src, size_t src_len, uint32_t *indices, float *re_im, uint32_t n_bins)
+{
+    if (src == NULL || (n_bins > 0 && (indices == NULL || re_im == NULL)))
+    {
+        return -1;
+    }
+    if (src_len < sizeof(float))
+    {
+        return -2;
+    }
+
+    float scale;
+    memcpy(&scale, src, sizeof(float));
+    size_t pos = sizeof(float);
+
+    uint32_t index = 0;
+    for (uint32_t i = 0; i < n_bins; i++)
+    {
+        uint32_t delta;
+        int len = data_codec_varint_decode(&src[pos], src_len - pos, &delta);
+        if (len < 0)
+        {
+            return -2;
+        }
+        pos += len;
+        index += delta;
+        indices[i] = index;
+    }
+
+    if (src_len - pos < (size_t)n_bins * 2 * sizeof(int16_t))
+    {
+        return -2;
+    }
+    for (uint32_t i = 0; i < 2 * n_bins; i++)
+    {
+        int16_t q16;
+        memcpy(&q16, &src[pos], sizeof(int16_t));
+        pos += sizeof(int16_t);
+        re_im[i] = (float)q16 * scale;
+    }
+    return (int)pos;
+}
+
+// MSB first bit stream over a byte buffer
+typedef struct dataCodecBitsType
+{
+    uint8_t *buffer;
+    size_t size_bits;
+    size_t position;
+} dataCodecBitsType;
+
+static inline bool data_codec_bits_write(dataCodecBitsType *bits, uint32_t value, uint32_t n_bits)
+{
+    if (bits->size_bits - bits->position < n_bits)
+    {
+        return false;
+    }
+    for (int bit = (int)n_bits - 1; bit >= 0; bit--)
+    {
+        size_t byte = bits->position >> 3;
+        uint8_t mask = (uint8_t)(0x80 >> (bits->position & 7));
+        if ((bits->position & 7) == 0)
+            bits->buffer[byte] = 0;
+        if ((value >> bit) & 1)
+            bits->buffer[byte] |= mask;
+        bits->position++;
+    }
+    return true;
+}
+
+static inline bool data_codec_bits_read(dataCodecBitsType *bits, uint32_t *value, uint32_t n_bits)
+{
+    if (bits->size_bits - bits->position < n_bits)
+    {
+        return false;
+    }
+    uint32_t result = 0;
+    for (uint32_t i = 0; i < n_bits; i++)
+    {
+        result = (result << 1) | ((bits->buffer[bits->position >> 3] >> (7 - (bits->position & 7))) & 1);
+        bits->position++;
+    }
+    *value = result;
+    return true;
+}
+
+// Prediction residual of sample i with a fixed polynomial predictor (i >= order)
+static inline int32_t data_codec_rice_residual(const int16_t *samples, uint32_t i, int order)
+{
+    switch (order)
+    {
+    case 0:
+        return samples[i];
+    case 1:
+        return (int32_t)samples[i] - samples[i - 1];
+    default:
+        return (int32_t)samples[i] - 2 * (int32_t)samples[i - 1] + samples[i - 2];
+    }
+}
+
+static inline uint32_t data_codec_zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+/**
+ * @brief Losslessly compress a block of int16 samples with a fixed predictor and Rice coding
+ *
+ * The block is self contained, so blocks can be encoded and decoded while streaming.
+ * Layout: u8 order | i16 warm-up samples[order] | bit stream (MSB first, padded to a byte)
+ * The bit stream holds one partition per DATA_CODEC_RICE_PARTITION residuals:
+ * 5 bit Rice parameter k, then per zigzag residual u: q = u >> k ones, a zero, and the k low bits of u.
+ * A quotient >= DATA_CODEC_RICE_ESCAPE is sent as DATA_CODEC_RICE_ESCAPE ones followed by u in 20 bits.
+ * The predictor order (0: x, 1: x - x1, 2: x - 2 x1 + x2) with the smallest residual sum is used.
+ *
+ * @param dst buffer that receives the block
+ * @param dst_size size of dst
+ * @param samples samples to compress
+ * @param n_samples number of samples
+ * @return >0 length of the compressed block
+ * @return -1 NULL pointers passed
+ * @return -2 dst too small (the block does not compress into dst_size)
+ */
+int data_codec_encode_rice(uint8_t *dst, size_t dst_size, const int16_t *samples, uint32_t n_samples)
+{
+    if (dst == NULL || (n_samples > 0 && samples == NULL))
+    {
+        return -1;
+    }
+
+    // Pick the predictor order with the smallest sum of absolute residuals
+    uint64_t residual_sum[DATA_CODEC_RICE_MAX_ORDER + 1] = {0};
+    for (uint32_t i = DATA_CODEC_RICE_MAX_ORDER; i < n_samples; i++)
+    {
+        for (int order = 0; order <= DATA_CODEC_RICE_MAX_ORDER; order++)
+        {
+            int32_t residual = data_codec_rice_residual(samples, i, order);
+            residual_sum[order] += (uint32_t)(residual < 0 ? -residual : residual);
+        }
+    }
+    int order = 0;
+    for (int i = 1; i <= DATA_CODEC_RICE_MAX_ORDER; i++)
+    {
+        if (residual_sum[i] < residual_sum[order])
+            order = i;
+    }
+    if ((uint32_t)order > n_samples)
+    {
+        order = (int)n_samples;
+    }
+
+    size_t header_size = 1 + order * sizeof(int16_t);
+    if (dst_size < header_size)
+    {
+        return -2;
+    }
+    dst[0] = (uint8_t)order;
+    memcpy(&dst[1], samples, order * sizeof(int16_t));
+
+    dataCodecBitsType bits = {.buffer = &dst[header_size], .size_bits = (dst_size - header_size) * 8, .position = 0};
+    for (uint32_t start = order; start < n_samples; start += DATA_CODEC_RICE_PARTITION)
+    {
+        uint32_t end = (n_samples - start < DATA_CODEC_RICE_PARTITION) ? n_samples : start + DATA_CODEC_RICE_PARTITION;
+
+        // Rice parameter from the mean zigzag residual of the partition
+        uint64_t sum = 0;
+        for (uint32_t i = start; i < end; i++)
+        {
+            sum += data_codec_zigzag(data_codec_rice_residual(samples, i, order));
+        }
+        uint32_t k = 0;
+        while (k < DATA_CODEC_RICE_ESCAPE_BITS && ((uint64_t)(end - start) << (k + 1)) < sum)
+        {
+            k++;
+        }
+        if (!data_codec_bits_write(&bits, k, DATA_CODEC_RICE_PARAM_BITS))
+        {
+            return -2;
+        }
+
+        for (uint32_t i = start; i < end; i++)
+        {
+            uint32_t u = data_codec_zigzag(data_codec_rice_residual(samples, i, order));
+            uint32_t q = u >> k;
+            bool ok;
+            if (q >= DATA_CODEC_RICE_ESCAPE)
+            {
+                ok = data_codec_bits_write(&bits, (1u << DATA_CODEC_RICE_ESCAPE) - 1, DATA_CODEC_RICE_ESCAPE) &&
+                     data_codec_bits_write(&bits, u, DATA_CODEC_RICE_ESCAPE_BITS);
+            }
+            else
+            {
+                // q ones and the terminating zero
+                ok = data_codec_bits_write(&bits, ((1u << q) - 1) << 1, q + 1) &&
+                     data_codec_bits_write(&bits, u & ((1u << k) - 1), k);
+            }
+            if (!ok)
+            {
+                return -2;
+            }
+        }
+    }
+    return (int)(header_size + (bits.position + 7) / 8);
+}
+
+/**
+ * @brief Decompress a block of data_codec_encode_rice
+ *
+ * @param src compressed block
+ * @param src_len length of the compressed block
+ * @param samples receives n_samples samples
+ * @param n_samples number of samples in the block (sent in the frame header)
+ * @return >0 number of bytes consumed
+ * @return -1 NULL pointers passed
+ * @return -2 block truncated or corrupted
+ */
+int data_codec_decode_rice(const uint8_t *src, size_t src_len, int16_t *samples, uint32_t n_samples)
+{
+    if (src == NULL || (n_samples > 0 && samples == NULL))
+    {
+        return -1;
+    }
+    if (src_len < 1 || src[0] > DATA_CODEC_RICE_MAX_ORDER || src[0] > n_samples)
+    {
+        return -2;
+    }
+    int order = src[0];
+    size_t header_size = 1 + order * sizeof(int16_t);
+    if (src_len < header_size)
+    {
+        return -2;
+    }
+    memcpy(samples, &src[1], order * sizeof(int16_t));
+
+    dataCodecBitsType bits = {.buffer = (uint8_t *)&src[header_size], .size_bits = (src_len - header_size) * 8, .position = 0};
+    for (uint32_t start = order; start < n_samples; start += DATA_CODEC_RICE_PARTITION)
+    {
+        uint32_t end = (n_samples - start < DATA_CODEC_RICE_PARTITION) ? n_samples : start + DATA_CODEC_RICE_PARTITION;
+        uint32_t k;
+        if (!data_codec_bits_read(&bits, &k, DATA_CODEC_RICE_PARAM_BITS) || k > DATA_CODEC_RICE_ESCAPE_BITS)
+        {
+            return -2;
+        }
+
+        for (uint32_t i = start; i < end; i++)
+        {
+            uint32_t q = 0, bit = 1, u = 0;
+            while (q < DATA_CODEC_RICE_ESCAPE)
+            {
+                if (!data_codec_bits_read(&bits, &bit, 1))
+                    return -2;
+                if (bit == 0)
+                    break;
+                q++;
+            }
+            if (q == DATA_CODEC_RICE_ESCAPE)
+            {
+                if (!data_codec_bits_read(&bits, &u, DATA_CODEC_RICE_ESCAPE_BITS))
+                    return -2;
+            }
+            else
+            {
+                uint32_t remainder = 0;
+                if (!data_codec_bits_read(&bits, &remainder, k))
+                    return -2;
+                u = (q << k) | remainder;
+            }
+
+            int32_t residual = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+            int32_t prediction = 0;
+            if (order == 1)
+                prediction = samples[i - 1];
+            else if (order == 2)
+                prediction = 2 * (int32_t)samples[i - 1] - samples[i - 2];
+            samples[i] = (int16_t)(prediction + residual);
+        }
+    }
+    return (int)(header_size + (bits.position + 7) / 8);
+}
@@ -0,0 +1,31 @@
+#ifndef DATA_CODEC_H
+#define DATA_CODEC_H
+
+// Portable payload encoders and decoders (no ESP-IDF dependencies, also built by host tools)
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#define DATA_CODEC_VARINT_MAX_SIZE 5 // Longest LEB128 encoding of a uint32_t
+
+// Upper bound of a packed spectrum of n bins: scale + index varints + int16 re, im pairs
+#define DATA_CODEC_SPECTRUM_MAX_SIZE(n) (sizeof(float) + (n) * (DATA_CODEC_VARINT_MAX_SIZE + 2 * sizeof(int16_t)))
+
+// Rice coded sample blocks
+#define DATA_CODEC_RICE_PARTITION 256  // Samples per Rice parameter
+#define DATA_CODEC_RICE_MAX_ORDER 2	   // Highest fixed predictor order
+#define DATA_CODEC_RICE_PARAM_BITS 5   // Bits of each Rice parameter
+#define DATA_CODEC_RICE_ESCAPE 24	   // Quotients >= this are sent as escape + 20 bit value
+#define DATA_CODEC_RICE_ESCAPE_BITS 20 // Zigzag residual of an order 2 int16 predictor fits in 19 bits
+
+size_t data_codec_varint_encode(uint8_t *dst, uint32_t value);
+int data_codec_varint_decode(const uint8_t *src, size_t src_len, uint32_t *value);
+int data_codec_encode_spectrum(uint8_t *dst, size_t dst_size, const uint32_t *indices, const float *re_im, uint32_t n_bins);
+int data_codec_decode_spectrum(const uint8_t *src, size_t src_len, uint32_t *indices, float *re_im, uint32_t n_bins);
+int data_codec_encode_rice(uint8_t *dst, size_t dst_size, const int16_t *samples, uint32_t n_samples);
+int data_codec_decode_rice(const uint8_t *src, size_t src_len, int16_t *samples, uint32_t n_samples);
+
+#endif // DATA_CODEC_H
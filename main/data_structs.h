@@ -1,8 +1,12 @@
 #ifndef DATA_STRUCTS_H
 #define DATA_STRUCTS_H
 
+#include <stdbool.h>
 #include <freertos/FreeRTOS.h>
 #include "constants.h"
+#include "capture_state.h"
+#include "fft_select.h"
+#include "fft_prepare.h"
 
 /**
  * @brief Data structure for storing the MPU6050 sensor data
@@ -34,15 +38,277 @@ typedef struct i2cBufferType
     uint8_t write_buffer[I2C_WRITE_BUFF_SIZE]; // write buffer
 } i2cBufferType;
 
+/**
+ * @brief State of a streamed MPU6050 FIFO read
+ *
+ * Only whole frames are read from the FIFO, a partially written frame stays in the FIFO
+ * until the next read, so frame alignment is kept across reads without resetting the FIFO.
+ */
+typedef struct mpuFifoStreamType
+{
+    // FIFO_EN register mask that defines the frame content
+    uint8_t fifo_en_mask;
+
+    // Bytes per FIFO frame
+    uint8_t frame_size;
+
+    // Frames drained since the stream was started
+    uint32_t frames_read;
+
+    // FIFO overflows since the stream was started (each one resets the FIFO and drops its content)
+    uint32_t overflows;
+} mpuFifoStreamType;
+
+/**
+ * @brief Multi-channel capture buffer (structure of arrays)
+ *
+ * Each captured channel has its own contiguous array of raw sensor counts. Conversion to physical
+ * units, value = (raw - bias) * scale, is done once per capture when the FFT input is prepared.
+ * Slots are filled in ascending channel order: samples[0] holds the lowest channel of the mask.
+ */
+typedef struct captureBufferType
+{
+    // Captured channels, bit i = mpu_data_t.accel_gyro_raw[i] (CAPTURE_CH_* masks)
+    uint8_t channel_mask;
+
+    // Number of channels set in channel_mask
+    uint8_t n_channels;
+
+    // Channel index (0..5) stored in each slot
+    uint8_t channels[CAPTURE_MAX_CHANNELS];
+
+    // Raw sample arrays of N_SAMPLES counts, one per slot
+    int16_t *samples[CAPTURE_MAX_CHANNELS];
+
+    // Samples per channel of the capture (power of 2, CAPTURE_MIN_SAMPLES..N_SAMPLES)
+    uint32_t n_samples;
+
+    // Calibration error of each slot when the capture started (raw counts)
+    float bias[CAPTURE_MAX_CHANNELS];
+
+    // Physical units (g or deg/s) per raw count of each slot
+    float scale[CAPTURE_MAX_CHANNELS];
+
+    // Owner of the buffer, changed only with capture_state_* transitions
+    captureStateType state;
+} captureBufferType;
+
+/**
+ * @brief Ring buffer of one raw channel for the streaming STFT mode
+ *
+ * Sample positions are absolute counts since the stream was started, the ring slot is
+ * position % size. Only the sampling task writes, the FFT task copies windows out of it.
+ */
+typedef struct streamRingType
+{
+    // Ring of raw counts
+    int16_t *samples;
+
+    // Ring length in samples
+    uint32_t size;
+
+    // Recorded channel (0..5) with its bias (raw counts) and scale (units per count)
+    uint8_t channel;
+    float bias;
+    float scale;
+
+    // Samples written since the stream was started
+    volatile uint32_t write_position;
+
+    // Absolute position of the first sample of the next window
+    uint32_t next_window_start;
+
+    // Windows lost because the FFT queue was full (sampling task only)
+    volatile uint32_t windows_dropped;
+
+    // Windows lost because the ring was overwritten before the copy (FFT task only)
+    volatile uint32_t windows_overwritten;
+} streamRingType;
+
+/**
+ * @brief Bank of Goertzel filters that track the amplitude of a few frequencies of one raw channel
+ *
+ * The sampling task updates every filter once per sample, the amplitudes are latched and
+ * the filters restarted every block_size samples.
+ */
+typedef struct goertzelBankType
+{
+    // Monitored channel (0..5) with its bias (raw counts) and scale (units per count)
+    uint8_t channel;
+    float bias;
+    float scale;
+
+    // Number of monitored frequencies
+    uint8_t n_freqs;
+
+    // Monitored frequencies (Hz) and their coefficients 2 cos(2 pi f / fs)
+    float freqs_hz[GOERTZEL_MAX_FREQS];
+    float coeffs[GOERTZEL_MAX_FREQS];
+
+    // Filter states s[n - 1] and s[n - 2]
+    float s1[GOERTZEL_MAX_FREQS];
+    float s2[GOERTZEL_MAX_FREQS];
+
+    // Samples per block and samples of the current block
+    uint32_t block_size;
+    uint32_t count;
+
+    // Blocks completed since the bank was configured
+    uint32_t block_index;
+
+    // Blocks lost because the result queue was full
+    volatile uint32_t blocks_dropped;
+} goertzelBankType;
+
+/**
+ * @brief Amplitudes of one completed Goertzel block, passed from the sampling task to the sender
+ */
+typedef struct goertzelResultType
+{
+    uint32_t block_index;
+    uint32_t block_size;
+    uint8_t channel;
+    uint8_t n_freqs;
+    float freqs_hz[GOERTZEL_MAX_FREQS];
+
+    // Amplitude of each frequency in g or deg/s
+    float amplitudes[GOERTZEL_MAX_FREQS];
+} goertzelResultType;
+
+// Origin of an FFT result
+typedef enum fft_source_type
+{
+    FFT_SOURCE_A = 0,      // capture buffer A
+    FFT_SOURCE_B = 1,      // capture buffer B
+    FFT_SOURCE_STREAM = 2, // streaming STFT window
+} fft_source_type;
+
+// Source of capture buffer id (0 = A, 1 = B, ids from 2 on follow the stream source)
+#define FFT_SOURCE_CAPTURE(capture_id) (((capture_id) < FFT_SOURCE_STREAM) ? (capture_id) : (capture_id) + 1)
+
+/**
+ * @brief Description of the FFT result that is waiting in the FFT buffers to be sent
+ */
+typedef struct fftResultInfoType
+{
+    // Transform size
+    uint32_t n_samples;
+
+    // Sampling rate of the transformed samples (Hz)
+    uint32_t sample_rate_hz;
+
+    // fft_source_type of the samples
+    uint8_t source;
+
+    // Channel (0..5, bit index of CAPTURE_CH_* masks)
+    uint8_t channel;
+
+    // Result is the peak list in fft_peak_list instead of ranked components
+    bool peaks;
+} fftResultInfoType;
+
+// Spectral peak refined between bins
+typedef struct fftPeakType
+{
+    // Interpolated frequency (Hz)
+    float freq_hz;
+
+    // Interpolated amplitude of the tone (g or deg/s)
+    float amplitude;
+} fftPeakType;
+
+/**
+ * @brief Peaks of one spectrum, strongest first
+ */
+typedef struct fftPeakListType
+{
+    uint32_t n_peaks;
+
+    // Mean noise floor of the spectrum as the amplitude of a bin (g or deg/s)
+    float noise_floor;
+
+    fftPeakType peaks[FFT_PEAK_MAX_PEAKS];
+} fftPeakListType;
+
 // Declare the variables as extern
 extern mpuDataType mpu_data_t;
 extern i2cBufferType i2c_buffer_t;
 
-typedef struct indexed_float_type
+// Spectrum calculation path, selected at runtime with fft_set_mode
+typedef enum fft_mode_type
 {
-    uint32_t index;
-    float value;
+    FFT_MODE_FC32, // float FFT on converted samples
+    FFT_MODE_SC16, // 16-bit fixed point FFT on raw counts with block scaling
+} fft_mode_type;
+
+// Payload encoding of the FFT results, selected at runtime with fft_set_encoding
+typedef enum fft_encoding_type
+{
+    FFT_ENCODING_RAW,    // u32 indices and f32 re, im pairs in ranking order
+    FFT_ENCODING_PACKED, // index sorted, delta varint indices and int16 re, im with one scale (data_codec)
+    FFT_ENCODING_PEAKS,  // interpolated peaks above the noise floor (fft_peaks, fc32 path only)
+} fft_encoding_type;
+
+/**
+ * @brief Complex FFT implementation used by fft_calculate_re_im
+ *
+ * transform computes the in place complex FFT of n_points re, im pairs with the output in natural order.
+ */
+typedef struct fftBackendType
+{
+    // Short name for logs and commands
+    const char *name;
+
+    // Sizes must be a power of this radix (2 or 4)
+    uint32_t radix;
+
+    // Prepare tables for transforms up to max_points, 0 OK
+    int (*init)(uint32_t max_points);
+
+    // Release the tables of init
+    void (*deinit)(void);
+
+    // In place FFT with natural order output, 0 OK
+    int (*transform)(float *data, uint32_t n_points);
+} fftBackendType;
+
+// State of the streaming UART receive parser
+typedef enum uart_rx_state_type
+{
+    UART_RX_HUNT,    // searching for the start flag, other bytes are dropped
+    UART_RX_MESSAGE, // storing the message until the end flag
+} uart_rx_state_type;
+
+/**
+ * @brief Counters of the UART receive path, reported with the RXSTATS command
+ */
+typedef struct uartRxStatsType
+{
+    uint32_t frames;          // messages passed to the message handler
+    uint32_t bytes_dropped;   // bytes outside of start / end flags
+    uint32_t errors_too_long; // messages longer than UART_MSG_MAX_LEN
+    uint32_t errors_empty;    // end flag right after the start flag
+    uint32_t errors_queue;    // message queue full, message dropped
+    uint32_t errors_rx;       // RX FIFO or ring buffer overflows, bytes were lost
+    uint32_t latency_us_last; // UART_DATA event to message queued, last message
+    uint32_t latency_us_max;  // UART_DATA event to message queued, worst case
+} uartRxStatsType;
+
+/**
+ * @brief Incremental parser of "++*" MESSAGE "*++" frames
+ *
+ * Bytes are fed as they arrive, partial flags and messages are kept between calls.
+ */
+typedef struct uartRxParserType
+{
+    uart_rx_state_type state;
+    uint8_t flag_pos; // matched bytes of the start flag (HUNT) or end flag (MESSAGE)
+    uint32_t msg_len; // stored bytes, including a partially matched end flag
+
+    // Completed message, '\0' terminated, valid until the next uart_rx_parser_feed call
+    char msg[UART_MSG_MAX_LEN + ENCAP_FLAG_SIZE + 1];
 
-} indexed_float_type;
+    uartRxStatsType stats;
+} uartRxParserType;
 
 #endif // DATA_STRUCTS_H
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "fft_ansi.h"
+
+// exp(-j 2 pi k / fft_ansi_max_points) for k = 0..max_points/2-1 as re, im pairs
+static float *fft_ansi_twiddles = NULL;
+static uint32_t fft_ansi_max_points = 0;
+
+/**
+ * @brief Prepare the twiddle table of the reference FFT
+ *
+ * @param max_points largest transform size in complex points (power of 2)
+ * @return 0 OK
+ * @return -1 size is not a power of 2
+ * @return -2 failed to allocate the twiddle table
+ */
+int fft_ansi_init(uint32_t max_points)
+{
+    if (max_points < 2 || (max_points & (max_points - 1)) != 0)
+    {
+        return -1;
+    }
+    if (fft_ansi_twiddles != NULL && max_points <= fft_ansi_max_points)
+    {
+        return 0;
+    }
+    fft_ansi_deinit();
+
+    fft_ansi_twiddles = (float *)malloc(max_points * sizeof(float));
+    if (fft_ansi_twiddles == NULL)
+    {
+        return -2;
+    }
+    for (uint32_t k = 0; k < max_points / 2; k++)
+    {
+        double angle = -2 * M_PI * k / max_points;
+        fft_ansi_twiddles[2 * k] = (float)cos(angle);
+        fft_ansi_twiddles[2 * k + 1] = (float)sin(angle);
+    }
+    fft_ansi_max_points = max_points;
+    return 0;
+}
+
+/**
+ * @brief Free the twiddle table
+ */
+void fft_ansi_deinit(void)
+{
+    free(fft_ansi_twiddles);
+    fft_ansi_twiddles = NULL;
+    fft_ansi_max_points = 0;
+}
+
+/**
+ * @brief In place radix-2 decimation in time complex FFT with output in natural order
+ *
+ * X[k] = sum x[i] exp(-j 2 pi i k / n), same convention and scaling as dsps_fft2r_fc32 + dsps_bit_rev_fc32.
+ *
+ * @param data n_points complex points as re, im pairs
+ * @param n_points transform size (power of 2, <= max_points of fft_ansi_init)
+ * @return 0 OK
+ * @return -1 not initialised for this size or size is not a power of 2
+ */
+int fft_ansi_fc32(float *data, uint32_t n_points)
+{
+    if (data == NULL || fft_ansi_twiddles == NULL || n_points > fft_ansi_max_points || (n_points & (n_points - 1)) != 0)
+    {
+        return -1;
+    }
+
+    // Bit reversal permutation
+    for (uint32_t i = 1, j = 0; i < n_points; i++)
+    {
+        uint32_t bit = n_points >> 1;
+        for (; j & bit; bit >>= 1)
+        {
+            j ^= bit;
+        }
+        j |= bit;
+        if (i < j)
+        {
+            float re = data[2 * i], im = data[2 * i + 1];
+            data[2 * i] = data[2 * j];
+            data[2 * i + 1] = data[2 * j + 1];
+            data[2 * j] = re;
+            data[2 * j + 1] = im;
+        }
+    }
+
+    // Butterflies, the twiddle of stage length len is table[k * max_points / len]
+    for (uint32_t len = 2; len <= n_points; len <<= 1)
+    {
+        uint32_t half = len / 2;
+        uint32_t stride = fft_ansi_max_points / len;
+        for (uint32_t start = 0; start < n_points; start += len)
+        {
+            for (uint32_t k = 0; k < half; k++)
+            {
+                float w_re = fft_ansi_twiddles[2 * k * stride];
+                float w_im = fft_ansi_twiddles[2 * k * stride + 1];
+                float *a = &data[2 * (start + k)];
+                float *b = &data[2 * (start + k + half)];
+                float t_re = b[0] * w_re - b[1] * w_im;
+                float t_im = b[0] * w_im + b[1] * w_re;
+                b[0] = a[0] - t_re;
+                b[1] = a[1] - t_im;
+                a[0] += t_re;
+                a[1] += t_im;
+            }
+        }
+    }
+    return 0;
+}
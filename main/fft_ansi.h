@@ -0,0 +1,14 @@
+#ifndef FFT_ANSI_H
+#define FFT_ANSI_H
+
+// Portable reference complex FFT (no ESP-IDF dependencies, also built by host tools)
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+int fft_ansi_init(uint32_t max_points);
+void fft_ansi_deinit(void);
+int fft_ansi_fc32(float *data, uint32_t n_points);
+
+#endif // FFT_ANSI_H
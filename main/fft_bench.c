@@ -0,0 +1,174 @@
+#include "fft_bench.h"
+
+static const char *fft_bench_stage_names[FFT_BENCH_N_STAGES] = {
+    "prepare",
+    "re_im",
+    "powers",
+    "percentile",
+    "select",
+};
+
+/**
+ * @brief Track the lowest free heap level seen during a benchmark run
+ *
+ * @param min_free_heap lowest free heap size seen so far
+ */
+static inline void fft_bench_update_min_heap(size_t *min_free_heap)
+{
+    size_t free_heap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    if (free_heap < *min_free_heap)
+        *min_free_heap = free_heap;
+}
+
+/**
+ * @brief Run the task_fft_calculation chain on a signal and measure each stage
+ *
+ * The chain of the active fft_mode_type is measured.
+ * Pipeline buffers are allocated here (same capabilities and alignment as in task_initialization),
+ * so the benchmark never touches fft_complex_arr, fft_power_arr or indexed_magnitudes that belong to the FFT task.
+ * The signal array is left unchanged.
+ *
+ * @param signal_arr input raw counts (at least n_samples long)
+ * @param bias raw count offset of the signal
+ * @param scale physical units per raw count
+ * @param n_samples number of samples to transform (power of 2, <= N_SAMPLES)
+ * @param iterations number of timed runs of the whole chain
+ * @param result struct that receives the measurements
+ * @return 0 OK
+ * @return -1 NULL pointers passed
+ * @return -2 invalid n_samples or iterations
+ * @return -3 failed to allocate pipeline buffers
+ */
+int fft_bench_run(const int16_t *signal_arr, float bias, float scale, uint32_t n_samples, uint32_t iterations, fft_bench_result_type *result)
+{
+    if (signal_arr == NULL || result == NULL)
+    {
+        return -1;
+    }
+    if (n_samples == 0 || n_samples > N_SAMPLES || (n_samples & (n_samples - 1)) != 0 || iterations == 0)
+    {
+        return -2;
+    }
+
+    memset(result, 0, sizeof(fft_bench_result_type));
+    result->mode = fft_get_mode();
+    result->n_samples = n_samples;
+    result->iterations = iterations;
+
+    uint32_t magnitudes_size = n_samples / 2;
+    size_t complex_bytes = FFT_COMPONENTS_LEN(n_samples) * sizeof(float);
+    size_t magnitudes_bytes = magnitudes_size * sizeof(indexed_float_type);
+    size_t powers_bytes = magnitudes_size * sizeof(float);
+
+    size_t start_free_heap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    size_t min_free_heap = start_free_heap;
+
+    float *complex_arr = (float *)heap_caps_aligned_alloc(16, complex_bytes, MALLOC_CAP_SPIRAM);
+    indexed_float_type *magnitudes_arr = (indexed_float_type *)heap_caps_malloc(magnitudes_bytes, MALLOC_CAP_SPIRAM);
+    float *power_arr = (float *)heap_caps_malloc(powers_bytes, MALLOC_CAP_SPIRAM);
+    if (complex_arr == NULL || magnitudes_arr == NULL || power_arr == NULL)
+    {
+        if (complex_arr != NULL)
+            heap_caps_free(complex_arr);
+        if (magnitudes_arr != NULL)
+            heap_caps_free(magnitudes_arr);
+        if (power_arr != NULL)
+            heap_caps_free(power_arr);
+        return -3;
+    }
+    result->buffers_bytes = complex_bytes + magnitudes_bytes + powers_bytes;
+    fft_bench_update_min_heap(&min_free_heap);
+
+    for (uint32_t iteration = 0; iteration < iterations; iteration++)
+    {
+        int64_t stage_start = 0;
+        int64_t run_start = esp_timer_get_time();
+        bool sc16 = (result->mode == FFT_MODE_SC16);
+        int shift = 0;
+
+        stage_start = esp_timer_get_time();
+        if (sc16)
+            shift = fft_sc16_prepare(signal_arr, bias, (int16_t *)complex_arr, n_samples);
+        else
+            fft_prepare_complex_arr_raw(signal_arr, bias, scale, complex_arr, n_samples);
+        result->stage_us[FFT_BENCH_STAGE_PREPARE] += esp_timer_get_time() - stage_start;
+        fft_bench_update_min_heap(&min_free_heap);
+
+        stage_start = esp_timer_get_time();
+        if (sc16)
+            fft_sc16_calculate_re_im((int16_t *)complex_arr, n_samples);
+        else
+            fft_calculate_re_im(complex_arr, n_samples);
+        result->stage_us[FFT_BENCH_STAGE_RE_IM] += esp_timer_get_time() - stage_start;
+        fft_bench_update_min_heap(&min_free_heap);
+
+        stage_start = esp_timer_get_time();
+        if (sc16)
+            fft_sc16_calculate_powers((indexed_uint_type *)magnitudes_arr, (int16_t *)complex_arr, magnitudes_size);
+        else
+            fft_calculate_powers(power_arr, complex_arr, magnitudes_size);
+        result->stage_us[FFT_BENCH_STAGE_POWERS] += esp_timer_get_time() - stage_start;
+        fft_bench_update_min_heap(&min_free_heap);
+
+        stage_start = esp_timer_get_time();
+        uint32_t n_ms_components = fft_percentile_n_components(FFT_MS_PERCENTILE, magnitudes_size);
+        result->stage_us[FFT_BENCH_STAGE_PERCENTILE] += esp_timer_get_time() - stage_start;
+
+        stage_start = esp_timer_get_time();
+        if (sc16)
+        {
+            fft_sc16_select_top_powers((indexed_uint_type *)magnitudes_arr, magnitudes_size, n_ms_components);
+            fft_sc16_to_fc32((int16_t *)complex_arr, (indexed_uint_type *)magnitudes_arr, n_samples, n_ms_components, shift, scale);
+        }
+        else
+            fft_select_top_powers(magnitudes_arr, power_arr, magnitudes_size, n_ms_components);
+        result->stage_us[FFT_BENCH_STAGE_SELECT] += esp_timer_get_time() - stage_start;
+        fft_bench_update_min_heap(&min_free_heap);
+
+        int64_t run_us = esp_timer_get_time() - run_start;
+        if (run_us > result->worst_total_us)
+            result->worst_total_us = run_us;
+
+        // Let the idle task feed the watchdog between runs
+        vTaskDelay(1);
+    }
+
+    heap_caps_free(complex_arr);
+    heap_caps_free(magnitudes_arr);
+    heap_caps_free(power_arr);
+
+    result->peak_heap_bytes = start_free_heap - min_free_heap;
+    result->stack_hwm = uxTaskGetStackHighWaterMark(NULL);
+    return 0;
+}
+
+/**
+ * @brief Log the benchmark result: per stage average time, throughput and memory
+ *
+ * @param signal_name name of the benchmarked signal (synthetic, recorded A, ...)
+ * @param result benchmark result filled by fft_bench_run
+ */
+void fft_bench_print_result(const char *signal_name, fft_bench_result_type *result)
+{
+    const char *TAG = "FFT BENCH";
+    if (signal_name == NULL || result == NULL || result->iterations == 0)
+    {
+        return;
+    }
+
+    int64_t total_us = 0;
+    for (int stage = 0; stage < FFT_BENCH_N_STAGES; stage++)
+    {
+        total_us += result->stage_us[stage];
+    }
+    int64_t avg_total_us = total_us / result->iterations;
+
+    ESP_LOGI(TAG, "%s, %s%s, N=%lu, %lu runs", signal_name, (result->mode == FFT_MODE_SC16) ? "sc16" : fft_get_backend_name(result->n_samples), (result->mode != FFT_MODE_SC16 && fft_get_dual_core()) ? " dual core" : "", result->n_samples, result->iterations);
+    for (int stage = 0; stage < FFT_BENCH_N_STAGES; stage++)
+    {
+        int64_t avg_us = result->stage_us[stage] / result->iterations;
+        ESP_LOGI(TAG, "  %-10s %8lld us (%4.1f %%)", fft_bench_stage_names[stage], avg_us, total_us ? (100.0f * result->stage_us[stage] / total_us) : 0.0f);
+    }
+    ESP_LOGI(TAG, "  total      %8lld us avg, %lld us worst, %.2f captures/s", avg_total_us, result->worst_total_us, avg_total_us ? (1e6f / avg_total_us) : 0.0f);
+    ESP_LOGI(TAG, "  buffers %u B, peak heap %u B, free stack %u B", result->buffers_bytes, result->peak_heap_bytes, result->stack_hwm);
+}
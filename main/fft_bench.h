@@ -0,0 +1,54 @@
+#ifndef FFT_BENCH_H
+#define FFT_BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "constants.h"
+#include "data_structs.h"
+#include "my_fft.h"
+#include "fft_bench_signal.h"
+
+// Stages of the task_fft_calculation chain, in the order they are executed
+typedef enum fft_bench_stage_type
+{
+    FFT_BENCH_STAGE_PREPARE,    // fft_prepare_complex_arr_raw (sc16: fft_sc16_prepare)
+    FFT_BENCH_STAGE_RE_IM,      // fft_calculate_re_im (sc16: fft_sc16_calculate_re_im)
+    FFT_BENCH_STAGE_POWERS,     // fft_calculate_powers (sc16: fft_sc16_calculate_powers)
+    FFT_BENCH_STAGE_PERCENTILE, // fft_percentile_n_components
+    FFT_BENCH_STAGE_SELECT,     // fft_select_top_powers (sc16: fft_sc16_select_top_powers + fft_sc16_to_fc32)
+    FFT_BENCH_N_STAGES
+} fft_bench_stage_type;
+
+typedef struct fft_bench_result_type
+{
+    fft_mode_type mode;
+    uint32_t n_samples;
+    uint32_t iterations;
+
+    // Time spent in each stage, summed over all iterations (us)
+    int64_t stage_us[FFT_BENCH_N_STAGES];
+
+    // Slowest single run of the whole chain (us)
+    int64_t worst_total_us;
+
+    // Bytes allocated for the pipeline buffers (complex array + indexed magnitudes + powers)
+    size_t buffers_bytes;
+
+    // Largest drop of free heap below the level before the run (buffers + anything the stages allocate)
+    size_t peak_heap_bytes;
+
+    // Free stack of the calling task after the run
+    UBaseType_t stack_hwm;
+} fft_bench_result_type;
+
+int fft_bench_run(const int16_t *signal_arr, float bias, float scale, uint32_t n_samples, uint32_t iterations, fft_bench_result_type *result);
+void fft_bench_print_result(const char *signal_name, fft_bench_result_type *result);
+
+#endif // FFT_BENCH_H
@@ -0,0 +1,31 @@
+#include "fft_bench_signal.h"
+
+/**
+ * @brief Generate a synthetic accelerometer signal in raw counts (1 g = MPU_ACCEL_FS)
+ *
+ * Three tones (50 Hz, 123.4 Hz and 333 Hz at 1 kHz sampling rate) on top of a 1 g offset and
+ * pseudo random noise. The noise generator is seeded with the same value on every call, so the
+ * benchmark input is identical between runs and firmware versions.
+ *
+ * @param signal_arr array that will hold the generated samples
+ * @param n_samples number of samples to generate
+ */
+void fft_bench_generate_signal(int16_t *signal_arr, uint32_t n_samples)
+{
+    uint32_t lcg_state = 0x12345678;
+    const float fs = 1000.0f;
+
+    for (uint32_t i = 0; i < n_samples; i++)
+    {
+        float t = (float)i / fs;
+        lcg_state = lcg_state * 1664525u + 1013904223u;
+        float noise = ((float)(lcg_state >> 8) / (float)(1 << 24)) - 0.5f;
+
+        float value_g = 1.0f +
+                        0.5f * sinf(2 * M_PI * 50.0f * t) +
+                        0.2f * sinf(2 * M_PI * 123.4f * t) +
+                        0.05f * sinf(2 * M_PI * 333.0f * t) +
+                        0.02f * noise;
+        signal_arr[i] = (int16_t)lrintf(value_g * MPU_ACCEL_FS);
+    }
+}
@@ -0,0 +1,12 @@
+#ifndef FFT_BENCH_SIGNAL_H
+#define FFT_BENCH_SIGNAL_H
+
+// Portable synthetic benchmark input (no ESP-IDF dependencies, also built by host tools)
+
+#include <stdint.h>
+#include <math.h>
+#include "constants.h"
+
+void fft_bench_generate_signal(int16_t *signal_arr, uint32_t n_samples);
+
+#endif // FFT_BENCH_SIGNAL_H
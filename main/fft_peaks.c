@@ -0,0 +1,156 @@
+#include "fft_peaks.h"
+
+/**
+ * @brief Median of a small array, the array is reordered (quickselect)
+ *
+ * @param values array of n values
+ * @param n number of values (> 0)
+ * @return median (upper median for an even n)
+ */
+static float fft_peaks_median(float *values, uint32_t n)
+{
+    uint32_t left = 0;
+    uint32_t right = n - 1;
+    uint32_t k = n / 2;
+    float tmp;
+
+    while (left < right)
+    {
+        // Partition around the middle element, which is parked at the right end
+        uint32_t middle = left + (right - left) / 2;
+        float pivot = values[middle];
+        values[middle] = values[right];
+        values[right] = pivot;
+
+        uint32_t store = left;
+        for (uint32_t i = left; i < right; i++)
+        {
+            if (values[i] < pivot)
+            {
+                tmp = values[i];
+                values[i] = values[store];
+                values[store] = tmp;
+                store++;
+            }
+        }
+        values[right] = values[store];
+        values[store] = pivot;
+
+        if (k == store)
+            break;
+        if (k < store)
+            right = store - 1;
+        else
+            left = store + 1;
+    }
+    return values[k];
+}
+
+/**
+ * @brief Insert a candidate into the peak list that is kept sorted by descending power
+ *
+ * @param bins bins of the kept candidates
+ * @param powers powers of the kept candidates
+ * @param n_kept number of kept candidates
+ * @param bin bin of the new candidate
+ * @param power power of the new candidate
+ * @return new number of kept candidates (at most FFT_PEAK_MAX_PEAKS)
+ */
+static uint32_t fft_peaks_insert(uint32_t *bins, float *powers, uint32_t n_kept, uint32_t bin, float power)
+{
+    if (n_kept == FFT_PEAK_MAX_PEAKS)
+    {
+        if (power <= powers[n_kept - 1])
+            return n_kept;
+        n_kept--;
+    }
+    uint32_t i = n_kept;
+    while (i > 0 && powers[i - 1] < power)
+    {
+        bins[i] = bins[i - 1];
+        powers[i] = powers[i - 1];
+        i--;
+    }
+    bins[i] = bin;
+    powers[i] = power;
+    return n_kept + 1;
+}
+
+/**
+ * @brief Find the strongest spectral peaks above an adaptive noise floor and refine them between bins
+ *
+ * The noise floor is the median power of every block of FFT_PEAK_FLOOR_BLOCK bins, so it follows a sloped
+ * floor and is not raised by the few bins of a tone. A bin is a peak if it is a local maximum and at least
+ * FFT_PEAK_THRESHOLD_DB above the floor of its block. Frequency and amplitude are refined with Gaussian
+ * interpolation (a parabola through the log powers of the peak and its neighbours), which is exact for
+ * a Gaussian main lobe and close for the Hann family of windows.
+ *
+ * Powers must come from fft_calculate_powers on a window normalized to unit coherent gain: a tone of
+ * amplitude A on a bin has the power (A * n_samples)^2.
+ *
+ * @param peak_list list that receives up to FFT_PEAK_MAX_PEAKS peaks, strongest first
+ * @param power_arr powers of bins 0..powers_size-1
+ * @param powers_size number of bins (half of the number of data samples)
+ * @param sample_rate_hz sampling rate of the transformed samples
+ * @return number of peaks found
+ * @return -1 NULL pointers passed or spectrum shorter than 3 bins
+ */
+int fft_peaks_find(fftPeakListType *peak_list, const float *power_arr, uint32_t powers_size, uint32_t sample_rate_hz)
+{
+    if (peak_list == NULL || power_arr == NULL || powers_size < 3)
+    {
+        return -1;
+    }
+
+    const float threshold = powf(10.0f, FFT_PEAK_THRESHOLD_DB / 10.0f);
+    float block_powers[FFT_PEAK_FLOOR_BLOCK];
+    uint32_t bins[FFT_PEAK_MAX_PEAKS];
+    float powers[FFT_PEAK_MAX_PEAKS];
+    uint32_t n_kept = 0;
+    double floor_sum = 0.0;
+    uint32_t n_blocks = 0;
+
+    for (uint32_t start = 0; start < powers_size; start += FFT_PEAK_FLOOR_BLOCK)
+    {
+        uint32_t end = start + FFT_PEAK_FLOOR_BLOCK;
+        if (end > powers_size)
+            end = powers_size;
+
+        memcpy(block_powers, &power_arr[start], (end - start) * sizeof(float));
+        float floor_power = fft_peaks_median(block_powers, end - start);
+        floor_sum += floor_power;
+        n_blocks++;
+
+        // Bin 0 (DC) and the last bin have only one neighbour and are never peaks
+        float min_power = floor_power * threshold;
+        for (uint32_t k = (start > 0) ? start : 1; k < end && k < powers_size - 1; k++)
+        {
+            float p = power_arr[k];
+            if (p > min_power && p > power_arr[k - 1] && p >= power_arr[k + 1])
+            {
+                n_kept = fft_peaks_insert(bins, powers, n_kept, k, p);
+            }
+        }
+    }
+
+    float n_samples = 2.0f * powers_size;
+    float bin_hz = (float)sample_rate_hz / n_samples;
+    for (uint32_t i = 0; i < n_kept; i++)
+    {
+        uint32_t k = bins[i];
+        float a = logf(fmaxf(power_arr[k - 1], FLT_MIN));
+        float b = logf(fmaxf(power_arr[k], FLT_MIN));
+        float c = logf(fmaxf(power_arr[k + 1], FLT_MIN));
+        float curvature = a - 2.0f * b + c;
+
+        // Offset of the vertex from bin k, within half a bin for a local maximum
+        float delta = (curvature < 0.0f) ? 0.5f * (a - c) / curvature : 0.0f;
+        float log_power = b - 0.25f * (a - c) * delta;
+
+        peak_list->peaks[i].freq_hz = ((float)k + delta) * bin_hz;
+        peak_list->peaks[i].amplitude = expf(0.5f * log_power) / n_samples;
+    }
+    peak_list->n_peaks = n_kept;
+    peak_list->noise_floor = sqrtf((float)(floor_sum / n_blocks)) / n_samples;
+    return (int)n_kept;
+}
@@ -0,0 +1,14 @@
+#ifndef FFT_PEAKS_H
+#define FFT_PEAKS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "constants.h"
+#include "data_structs.h"
+
+int fft_peaks_find(fftPeakListType *peak_list, const float *power_arr, uint32_t powers_size, uint32_t sample_rate_hz);
+
+#endif // FFT_PEAKS_H
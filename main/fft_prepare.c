@@ -0,0 +1,171 @@
+#include "fft_prepare.h"
+
+/**
+ * @brief Fill a half window table with a cosine sum window normalized to unit coherent gain
+ *
+ * w[i] = (a0 - a1 cos(x) + a2 cos(2x) - a3 cos(3x) + a4 cos(4x)) / a0, x = 2 pi i / table_n.
+ * Dividing by a0 (the mean of the window) keeps the amplitude of a tone on a bin unchanged.
+ * Only w[0..table_n/2] is stored (w[i] = w[table_n - i]).
+ *
+ * @param window_table array of table_n / 2 + 1 coefficients
+ * @param table_n length of the periodic window (power of 2)
+ * @param window window type
+ */
+void fft_window_table_fill(float *window_table, uint32_t table_n, fft_window_type window)
+{
+    double a[5] = {1.0, 0.0, 0.0, 0.0, 0.0};
+    switch (window)
+    {
+    case FFT_WINDOW_HANN:
+        a[0] = 0.5, a[1] = 0.5;
+        break;
+    case FFT_WINDOW_HAMMING:
+        a[0] = 0.54, a[1] = 0.46;
+        break;
+    case FFT_WINDOW_BLACKMAN_HARRIS:
+        a[0] = 0.35875, a[1] = 0.48829, a[2] = 0.14128, a[3] = 0.01168;
+        break;
+    case FFT_WINDOW_FLAT_TOP:
+        a[0] = 0.21557895, a[1] = 0.41663158, a[2] = 0.277263158, a[3] = 0.083578947, a[4] = 0.006947368;
+        break;
+    default:
+        break;
+    }
+    for (uint32_t i = 0; i <= table_n / 2; i++)
+    {
+        double x = 2 * M_PI * i / table_n;
+        double w = a[0] - a[1] * cos(x) + a[2] * cos(2 * x) - a[3] * cos(3 * x) + a[4] * cos(4 * x);
+        window_table[i] = (float)(w / a[0]);
+    }
+}
+
+/**
+ * @brief Window samples and pack them into an fft array in one pass
+ *
+ * dst[i * dst_stride] = (raw[i] * scale + offset) * window[(i - start) * window_step] for i = start..end-1,
+ * with a zero imaginary part if dst_stride is 2. The loop is unrolled by 4.
+ *
+ * @param raw_arr raw sensor counts
+ * @param scale physical units per raw count
+ * @param offset added after scaling (-bias * scale)
+ * @param dst fft array
+ * @param dst_stride 1 for real input packing, 2 for complex input
+ * @param start first sample
+ * @param end sample after the last one
+ * @param window coefficient of sample start
+ * @param window_step table stride, negative on the mirrored half
+ */
+static inline void fft_window_pack(const int16_t *raw_arr, float scale, float offset, float *dst, uint32_t dst_stride,
+                                   uint32_t start, uint32_t end, const float *window, int32_t window_step)
+{
+    uint32_t i = start;
+    for (; i + 4 <= end; i += 4)
+    {
+        float w0 = window[0];
+        float w1 = window[window_step];
+        float w2 = window[2 * window_step];
+        float w3 = window[3 * window_step];
+        dst[i * dst_stride] = ((float)raw_arr[i] * scale + offset) * w0;
+        dst[(i + 1) * dst_stride] = ((float)raw_arr[i + 1] * scale + offset) * w1;
+        dst[(i + 2) * dst_stride] = ((float)raw_arr[i + 2] * scale + offset) * w2;
+        dst[(i + 3) * dst_stride] = ((float)raw_arr[i + 3] * scale + offset) * w3;
+        if (dst_stride == 2)
+        {
+            dst[2 * i + 1] = 0;
+            dst[2 * i + 3] = 0;
+            dst[2 * i + 5] = 0;
+            dst[2 * i + 7] = 0;
+        }
+        window += 4 * window_step;
+    }
+    for (; i < end; i++)
+    {
+        dst[i * dst_stride] = ((float)raw_arr[i] * scale + offset) * window[0];
+        if (dst_stride == 2)
+            dst[2 * i + 1] = 0;
+        window += window_step;
+    }
+}
+
+/**
+ * @brief Window and pack n samples, the first half reads the table forwards and the second half mirrored
+ *
+ * The window of a shorter power of 2 length n is w[i * table_n / n], so one table serves every transform size.
+ *
+ * @param raw_arr raw sensor counts
+ * @param scale physical units per raw count
+ * @param offset added after scaling (-bias * scale)
+ * @param window_table half window table from fft_window_table_fill
+ * @param table_n window length the table was filled for
+ * @param dst fft array
+ * @param dst_stride 1 for real input packing, 2 for complex input
+ * @param n_samples number of samples (power of 2, <= table_n)
+ */
+void fft_window_pack_raw(const int16_t *raw_arr, float scale, float offset, const float *window_table, uint32_t table_n,
+                         float *dst, uint32_t dst_stride, uint32_t n_samples)
+{
+    int32_t step = table_n / n_samples;
+    fft_window_pack(raw_arr, scale, offset, dst, dst_stride, 0, n_samples / 2, window_table, step);
+    fft_window_pack(raw_arr, scale, offset, dst, dst_stride, n_samples / 2, n_samples, &window_table[table_n / 2], -step);
+}
+
+/**
+ * @brief Fill the quarter wave cosine table of the real input split step
+ *
+ * @param cos_table array of table_n / 4 + 1 values, cos(2*pi*i/table_n)
+ * @param table_n largest number of real samples (power of 2)
+ */
+void fft_real_cos_table_fill(float *cos_table, uint32_t table_n)
+{
+    for (uint32_t i = 0; i <= table_n / 4; i++)
+    {
+        cos_table[i] = (float)cos(2 * M_PI * i / table_n);
+    }
+}
+
+/**
+ * @brief Unpack the spectrum of a real signal from the half size complex FFT of its packed samples
+ *
+ * Input is Z[k], the n_samples/2 point FFT of z[i] = x[2i] + j*x[2i+1] in natural order.
+ * With A = Z[k] and B = conj(Z[n/2-k]) the spectrum of x is 2X[k] = (A + B) - j*W^k*(A - B).
+ * Bins k and n/2-k are computed together in place. The output matches dsps_cplx2reC_fc32:
+ * bin 0 holds X[0] with zero im part, bins 1..n/2-1 hold 2X[k].
+ *
+ * @param complex_arr n_samples/2 complex points, overwritten with bins 0..n_samples/2-1
+ * @param n_samples number of real samples (power of 2, <= table_n)
+ * @param cos_table quarter wave table from fft_real_cos_table_fill
+ * @param table_n number of real samples the table was filled for
+ */
+void fft_real_split_table(float *complex_arr, uint32_t n_samples, const float *cos_table, uint32_t table_n)
+{
+    uint32_t half = n_samples / 2;
+    uint32_t stride = table_n / n_samples;
+    uint32_t quarter = table_n / 4;
+
+    if (complex_arr == NULL || cos_table == NULL || half == 0)
+        return;
+
+    complex_arr[0] = complex_arr[0] + complex_arr[1];
+    complex_arr[1] = 0;
+
+    for (uint32_t k = 1; k <= half / 2; k++)
+    {
+        uint32_t m = half - k;
+        float c = cos_table[k * stride];
+        float s = cos_table[quarter - k * stride];
+
+        float sum_re = complex_arr[2 * k] + complex_arr[2 * m];
+        float sum_im = complex_arr[2 * k + 1] - complex_arr[2 * m + 1];
+        float diff_re = complex_arr[2 * k] - complex_arr[2 * m];
+        float diff_im = complex_arr[2 * k + 1] + complex_arr[2 * m + 1];
+
+        // -j*W^k*(A - B) with W^k = c - j*s
+        float twiddled_re = c * diff_im - s * diff_re;
+        float twiddled_im = s * diff_im + c * diff_re;
+
+        complex_arr[2 * k] = sum_re + twiddled_re;
+        complex_arr[2 * k + 1] = sum_im - twiddled_im;
+        complex_arr[2 * m] = sum_re - twiddled_re;
+        complex_arr[2 * m + 1] = -sum_im - twiddled_im;
+    }
+}
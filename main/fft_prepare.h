@@ -0,0 +1,26 @@
+#ifndef FFT_PREPARE_H
+#define FFT_PREPARE_H
+
+// Portable windowing, input packing and real input split (no ESP-IDF dependencies, also built by host tools)
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+// Window applied to the samples before the FFT, selected at runtime with fft_set_window
+typedef enum fft_window_type
+{
+    FFT_WINDOW_RECT,            // no window
+    FFT_WINDOW_HANN,            // 0.5 - 0.5 cos
+    FFT_WINDOW_HAMMING,         // 0.54 - 0.46 cos
+    FFT_WINDOW_BLACKMAN_HARRIS, // 4 term, -92 dB side lobes
+    FFT_WINDOW_FLAT_TOP,        // 5 term, amplitude accurate between bins
+} fft_window_type;
+
+void fft_window_table_fill(float *window_table, uint32_t table_n, fft_window_type window);
+void fft_window_pack_raw(const int16_t *raw_arr, float scale, float offset, const float *window_table, uint32_t table_n,
+                         float *dst, uint32_t dst_stride, uint32_t n_samples);
+void fft_real_cos_table_fill(float *cos_table, uint32_t table_n);
+void fft_real_split_table(float *complex_arr, uint32_t n_samples, const float *cos_table, uint32_t table_n);
+
+#endif // FFT_PREPARE_H
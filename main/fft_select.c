@@ -0,0 +1,222 @@
+#include "fft_select.h"
+
+/**
+ * @brief Define the bounded min-heap selection for an indexed type with a key_type value
+ *
+ * fft_select_heap_<suffix>(heap, keys, key_stride, n_keys, n_top) moves the n_top largest keys
+ * keys[i * key_stride] (i = 0..n_keys-1) to heap[0..n_top) as (i, key), sorted in descending order.
+ * The first n_top keys are kept as a min-heap while the rest are scanned, so most keys cost a single
+ * compare against the heap root, and a bin index is only written when its key enters the heap.
+ * The keys may be the values of the heap array itself (key_stride of one element): slot i is only
+ * written after key i was read and keys behind the heap are never written. n_top must be <= n_keys.
+ */
+#define FFT_SELECT_DEFINE_HEAP(suffix, indexed_type, key_type)                                                      \
+    static inline void fft_heap_sift_down_##suffix(indexed_type *heap, uint32_t heap_size, uint32_t root)          \
+    {                                                                                                               \
+        indexed_type item = heap[root];                                                                             \
+        while (1)                                                                                                   \
+        {                                                                                                           \
+            uint32_t child = 2 * root + 1;                                                                          \
+            if (child >= heap_size)                                                                                 \
+                break;                                                                                              \
+            /* Pick the smaller of both children */                                                                 \
+            if (child + 1 < heap_size && heap[child + 1].value < heap[child].value)                                 \
+                child++;                                                                                            \
+            if (heap[child].value >= item.value)                                                                    \
+                break;                                                                                              \
+            heap[root] = heap[child];                                                                               \
+            root = child;                                                                                           \
+        }                                                                                                           \
+        heap[root] = item;                                                                                          \
+    }                                                                                                               \
+                                                                                                                    \
+    static void fft_select_heap_##suffix(indexed_type *heap, const key_type *keys, uint32_t key_stride,            \
+                                         uint32_t n_keys, uint32_t n_top)                                          \
+    {                                                                                                               \
+        indexed_type tmp;                                                                                           \
+        if (n_top == 0)                                                                                             \
+            return;                                                                                                 \
+                                                                                                                    \
+        /* Build a min-heap out of the first n_top keys */                                                          \
+        for (uint32_t i = 0; i < n_top; i++)                                                                        \
+        {                                                                                                           \
+            key_type key = keys[i * key_stride];                                                                    \
+            heap[i].index = i;                                                                                      \
+            heap[i].value = key;                                                                                    \
+        }                                                                                                           \
+        for (uint32_t i = n_top / 2; i-- > 0;)                                                                      \
+        {                                                                                                           \
+            fft_heap_sift_down_##suffix(heap, n_top, i);                                                            \
+        }                                                                                                           \
+                                                                                                                    \
+        /* Keep the n_top largest keys in the heap */                                                               \
+        key_type heap_min = heap[0].value;                                                                          \
+        for (uint32_t i = n_top; i < n_keys; i++)                                                                   \
+        {                                                                                                           \
+            key_type key = keys[i * key_stride];                                                                    \
+            if (key > heap_min)                                                                                     \
+            {                                                                                                       \
+                heap[0].index = i;                                                                                  \
+                heap[0].value = key;                                                                                \
+                fft_heap_sift_down_##suffix(heap, n_top, 0);                                                        \
+                heap_min = heap[0].value;                                                                           \
+            }                                                                                                       \
+        }                                                                                                           \
+                                                                                                                    \
+        /* Heap sort: moving the smallest element to the back leaves the heap in descending order */               \
+        for (uint32_t end = n_top - 1; end > 0; end--)                                                              \
+        {                                                                                                           \
+            tmp = heap[0];                                                                                          \
+            heap[0] = heap[end];                                                                                    \
+            heap[end] = tmp;                                                                                        \
+            fft_heap_sift_down_##suffix(heap, end, 0);                                                              \
+        }                                                                                                           \
+    }
+
+FFT_SELECT_DEFINE_HEAP(float, indexed_float_type, float)
+FFT_SELECT_DEFINE_HEAP(uint, indexed_uint_type, uint32_t)
+
+/**
+ * @brief Calculate the power re^2 + im^2 of every bin from FFT results
+ *
+ * Power is monotonic in magnitude, so ranking works on powers and the sqrtf and 1/n scaling are
+ * deferred to the few bins selected by fft_select_top_powers. Bin indices stay implicit in the
+ * array position. The loop is unrolled by 4 bins so the loads and multiply-adds of independent
+ * bins can overlap in the FPU pipeline.
+ *
+ * @param power_arr array that receives powers_size powers
+ * @param fft_complex_arr array of fft complex components [re0, im0, re1, im1, ...]
+ * @param powers_size number of bins (half of the number of data samples)
+ */
+void fft_calculate_powers(float *power_arr, const float *fft_complex_arr, uint32_t powers_size)
+{
+    if (power_arr == NULL || fft_complex_arr == NULL)
+    {
+        return;
+    }
+
+    uint32_t i = 0;
+    for (; i + 4 <= powers_size; i += 4)
+    {
+        const float *bins = &fft_complex_arr[2 * i];
+        float p0 = bins[0] * bins[0] + bins[1] * bins[1];
+        float p1 = bins[2] * bins[2] + bins[3] * bins[3];
+        float p2 = bins[4] * bins[4] + bins[5] * bins[5];
+        float p3 = bins[6] * bins[6] + bins[7] * bins[7];
+        power_arr[i] = p0;
+        power_arr[i + 1] = p1;
+        power_arr[i + 2] = p2;
+        power_arr[i + 3] = p3;
+    }
+    for (; i < powers_size; i++)
+    {
+        power_arr[i] = fft_complex_arr[2 * i] * fft_complex_arr[2 * i] + fft_complex_arr[2 * i + 1] * fft_complex_arr[2 * i + 1];
+    }
+}
+
+/**
+ * @brief Move the n_top largest indexed magnitudes to the front of the array, sorted in descending order.
+ *
+ * Replacement for fft_sort_magnitudes when only the most significant components are needed.
+ * The magnitudes must be in bin order (as written by fft_calculate_magnitudes), the selected
+ * elements get their position as index. After the call indexed_mangitudes[0..n_top) is identical
+ * to the start of a fully sorted array (up to the order of equal values), the rest of the array
+ * is left unchanged.
+ *
+ * @param indexed_mangitudes array of indexed magnitudes
+ * @param magnitudes_size size of the array
+ * @param n_top number of largest elements to select (clamped to magnitudes_size)
+ */
+void fft_select_top_magnitudes(indexed_float_type *indexed_mangitudes, uint32_t magnitudes_size, uint32_t n_top)
+{
+    if (indexed_mangitudes == NULL)
+    {
+        return;
+    }
+    if (n_top > magnitudes_size)
+        n_top = magnitudes_size;
+
+    fft_select_heap_float(indexed_mangitudes, &indexed_mangitudes[0].value, sizeof(indexed_float_type) / sizeof(float), magnitudes_size, n_top);
+}
+
+/**
+ * @brief Select the n_top largest bins of a power spectrum as indexed magnitudes, sorted in descending order
+ *
+ * The powers are read from a plain array and a bin index is only written when the bin enters the heap.
+ * Only the n_top selected bins are converted to magnitudes scaled like fft_calculate_magnitudes,
+ * sqrtf(power / n_samples).
+ *
+ * @param indexed_magnitudes array that receives n_top indexed magnitudes
+ * @param power_arr array of powers from fft_calculate_powers
+ * @param powers_size number of bins (half of the number of data samples)
+ * @param n_top number of largest bins to select (clamped to powers_size)
+ */
+void fft_select_top_powers(indexed_float_type *indexed_magnitudes, const float *power_arr, uint32_t powers_size, uint32_t n_top)
+{
+    if (indexed_magnitudes == NULL || power_arr == NULL)
+    {
+        return;
+    }
+    if (n_top > powers_size)
+        n_top = powers_size;
+
+    fft_select_heap_float(indexed_magnitudes, power_arr, 1, powers_size, n_top);
+
+    // Normalised by the transform size, so windows of different sizes give comparable magnitudes
+    float n_samples = 2.0f * powers_size;
+    for (uint32_t i = 0; i < n_top; i++)
+    {
+        indexed_magnitudes[i].value = sqrtf(indexed_magnitudes[i].value / n_samples);
+    }
+}
+
+/**
+ * @brief Calculate integer powers (re^2 + im^2) of the sc16 FFT bins
+ *
+ * Indices stay implicit like in fft_calculate_powers, fft_sc16_select_top_powers writes them.
+ *
+ * @param indexed_powers_arr array that receives the powers in bin order
+ * @param sc16_arr sc16 FFT result
+ * @param powers_size number of bins (half of the number of data samples)
+ */
+void fft_sc16_calculate_powers(indexed_uint_type *indexed_powers_arr, const int16_t *sc16_arr, uint32_t powers_size)
+{
+    for (uint32_t i = 0; i < powers_size; i++)
+    {
+        int32_t re = sc16_arr[2 * i];
+        int32_t im = sc16_arr[2 * i + 1];
+        indexed_powers_arr[i].value = (uint32_t)(re * re) + (uint32_t)(im * im);
+    }
+}
+
+/**
+ * @brief Integer counterpart of fft_select_top_magnitudes for the sc16 path
+ *
+ * @param indexed_powers array of powers in bin order from fft_sc16_calculate_powers
+ * @param powers_size size of the array
+ * @param n_top number of largest elements to select (clamped to powers_size)
+ */
+void fft_sc16_select_top_powers(indexed_uint_type *indexed_powers, uint32_t powers_size, uint32_t n_top)
+{
+    if (indexed_powers == NULL)
+        return;
+    if (n_top > powers_size)
+        n_top = powers_size;
+
+    fft_select_heap_uint(indexed_powers, &indexed_powers[0].value, sizeof(indexed_uint_type) / sizeof(uint32_t), powers_size, n_top);
+}
+
+/**
+ * @brief Calculate how many elements to print out depending on the percentile
+ *
+ * If we have an array of size 100, then 95th percentile index is i = 95,
+ * therefore in a sorted array first (100-95)=5 elements are 95th percentile.
+ *
+ * @param percentile: 0 <= float < 100
+ * @param arr_len: array length
+ * @return uint32_t
+ */
+uint32_t fft_percentile_n_components(float percentile, uint32_t arr_len)
+{
+    return arr_len - ((percentile / 100) * arr_len);
+}
@@ -0,0 +1,32 @@
+#ifndef FFT_SELECT_H
+#define FFT_SELECT_H
+
+// Portable ranking of spectrum bins (no ESP-IDF dependencies, also built by host tools)
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+typedef struct indexed_float_type
+{
+    uint32_t index;
+    float value;
+
+} indexed_float_type;
+
+// Same layout as indexed_float_type, used for integer powers of the sc16 FFT path
+typedef struct indexed_uint_type
+{
+    uint32_t index;
+    uint32_t value;
+
+} indexed_uint_type;
+
+void fft_calculate_powers(float *power_arr, const float *fft_complex_arr, uint32_t powers_size);
+void fft_select_top_magnitudes(indexed_float_type *indexed_mangitudes, uint32_t magnitudes_size, uint32_t n_top);
+void fft_select_top_powers(indexed_float_type *indexed_magnitudes, const float *power_arr, uint32_t powers_size, uint32_t n_top);
+void fft_sc16_calculate_powers(indexed_uint_type *indexed_powers_arr, const int16_t *sc16_arr, uint32_t powers_size);
+void fft_sc16_select_top_powers(indexed_uint_type *indexed_powers, uint32_t powers_size, uint32_t n_top);
+uint32_t fft_percentile_n_components(float percentile, uint32_t arr_len);
+
+#endif // FFT_SELECT_H
@@ -0,0 +1,144 @@
+#include "goertzel_bank.h"
+
+/**
+ * @brief Select the channel and frequencies of a Goertzel bank and restart it
+ *
+ * Must not be called while the bank is running. The current calibration error of the channel is latched as bias.
+ *
+ * @param bank Goertzel bank
+ * @param channel monitored channel (0..5)
+ * @param freqs_hz frequencies to monitor (0 < f < MPU_SAMPLING_RATE_HZ / 2)
+ * @param n_freqs number of frequencies (1..GOERTZEL_MAX_FREQS)
+ * @param block_size samples per reported block
+ * @param mpu_data_t struct with avg_err used as bias (NULL for zero bias)
+ * @return 0 OK
+ * @return -1 NULL pointer passed or invalid channel
+ * @return -2 invalid number of frequencies, frequency or block size
+ */
+int goertzel_bank_configure(goertzelBankType *bank, uint8_t channel, const float *freqs_hz, uint8_t n_freqs, uint32_t block_size, const mpuDataType *mpu_data_t)
+{
+    if (bank == NULL || freqs_hz == NULL || channel >= CAPTURE_N_CHANNELS)
+    {
+        return -1;
+    }
+    if (n_freqs == 0 || n_freqs > GOERTZEL_MAX_FREQS || block_size == 0)
+    {
+        return -2;
+    }
+    for (uint8_t i = 0; i < n_freqs; i++)
+    {
+        if (!(freqs_hz[i] > 0.0f && freqs_hz[i] < MPU_SAMPLING_RATE_HZ / 2.0f))
+        {
+            return -2;
+        }
+    }
+
+    memset(bank, 0, sizeof(goertzelBankType));
+    bank->channel = channel;
+    bank->bias = (mpu_data_t != NULL) ? mpu_data_t->avg_err[channel] : 0.0f;
+    bank->scale = (channel < 3) ? (1.0f / MPU_ACCEL_FS) : (1.0f / MPU_GYRO_FS);
+    bank->n_freqs = n_freqs;
+    bank->block_size = block_size;
+    for (uint8_t i = 0; i < n_freqs; i++)
+    {
+        bank->freqs_hz[i] = freqs_hz[i];
+        bank->coeffs[i] = (float)(2.0 * cos(2 * M_PI * freqs_hz[i] / MPU_SAMPLING_RATE_HZ));
+    }
+    return 0;
+}
+
+/**
+ * @brief Clear the filter states and start a new block
+ *
+ * @param bank Goertzel bank
+ */
+void goertzel_bank_reset(goertzelBankType *bank)
+{
+    memset(bank->s1, 0, sizeof(bank->s1));
+    memset(bank->s2, 0, sizeof(bank->s2));
+    bank->count = 0;
+}
+
+/**
+ * @brief Feed one sample to every filter of the bank and report a completed block
+ *
+ * Each filter costs one multiply and two adds per sample: s[n] = x[n] + coeff * s[n - 1] - s[n - 2].
+ * At the end of a block |X(f)|^2 = s1^2 + s2^2 - coeff * s1 * s2 gives the amplitude 2 |X(f)| / block_size
+ * of a sine at f (rectangular window, the frequency does not have to fall on a DFT bin).
+ *
+ * @param bank Goertzel bank
+ * @param sample raw count of the monitored channel
+ * @param result struct that receives the amplitudes when the block is completed
+ * @return true if the sample completed a block (the filters are restarted)
+ */
+bool goertzel_bank_push(goertzelBankType *bank, int16_t sample, goertzelResultType *result)
+{
+    float x = ((float)sample - bank->bias) * bank->scale;
+    for (uint8_t i = 0; i < bank->n_freqs; i++)
+    {
+        float s0 = x + bank->coeffs[i] * bank->s1[i] - bank->s2[i];
+        bank->s2[i] = bank->s1[i];
+        bank->s1[i] = s0;
+    }
+    if (++bank->count < bank->block_size)
+    {
+        return false;
+    }
+
+    float amplitude_scale = 2.0f / bank->block_size;
+    result->block_index = bank->block_index++;
+    result->block_size = bank->block_size;
+    result->channel = bank->channel;
+    result->n_freqs = bank->n_freqs;
+    for (uint8_t i = 0; i < bank->n_freqs; i++)
+    {
+        float s1 = bank->s1[i];
+        float s2 = bank->s2[i];
+        float power = s1 * s1 + s2 * s2 - bank->coeffs[i] * s1 * s2;
+        result->freqs_hz[i] = bank->freqs_hz[i];
+        result->amplitudes[i] = amplitude_scale * sqrtf(power > 0.0f ? power : 0.0f);
+    }
+    goertzel_bank_reset(bank);
+    return true;
+}
+
+/**
+ * @brief Encode a completed block as a GOERTZEL frame payload
+ *
+ * Payload layout (little endian):
+ * u8 channel | u8 n_freqs | u16 reserved | u32 sample_rate_hz | u32 block_size | u32 block_index | n_freqs * (f32 freq_hz, f32 amplitude)
+ *
+ * @param result completed block
+ * @param payload_buffer buffer that receives the payload
+ * @param payload_size size of payload_buffer
+ * @return >0 length of the payload
+ * @return -1 NULL pointer passed
+ * @return -2 payload buffer too small
+ */
+int goertzel_bank_encode_result(const goertzelResultType *result, uint8_t *payload_buffer, size_t payload_size)
+{
+    if (result == NULL || payload_buffer == NULL)
+    {
+        return -1;
+    }
+    size_t payload_len = GOERTZEL_HEADER_SIZE + result->n_freqs * 2 * sizeof(float);
+    if (payload_size < payload_len)
+    {
+        return -2;
+    }
+
+    uint32_t sample_rate_hz = MPU_SAMPLING_RATE_HZ;
+    payload_buffer[0] = result->channel;
+    payload_buffer[1] = result->n_freqs;
+    payload_buffer[2] = 0;
+    payload_buffer[3] = 0;
+    memcpy(&payload_buffer[4], &sample_rate_hz, sizeof(uint32_t));
+    memcpy(&payload_buffer[8], &result->block_size, sizeof(uint32_t));
+    memcpy(&payload_buffer[12], &result->block_index, sizeof(uint32_t));
+    for (uint8_t i = 0; i < result->n_freqs; i++)
+    {
+        memcpy(&payload_buffer[GOERTZEL_HEADER_SIZE + i * 8], &result->freqs_hz[i], sizeof(float));
+        memcpy(&payload_buffer[GOERTZEL_HEADER_SIZE + i * 8 + 4], &result->amplitudes[i], sizeof(float));
+    }
+    return (int)payload_len;
+}
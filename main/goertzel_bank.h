@@ -0,0 +1,16 @@
+#ifndef GOERTZEL_BANK_H
+#define GOERTZEL_BANK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "constants.h"
+#include "data_structs.h"
+
+int goertzel_bank_configure(goertzelBankType *bank, uint8_t channel, const float *freqs_hz, uint8_t n_freqs, uint32_t block_size, const mpuDataType *mpu_data_t);
+void goertzel_bank_reset(goertzelBankType *bank);
+bool goertzel_bank_push(goertzelBankType *bank, int16_t sample, goertzelResultType *result);
+int goertzel_bank_encode_result(const goertzelResultType *result, uint8_t *payload_buffer, size_t payload_size);
+
+#endif // GOERTZEL_BANK_H
@@ -14,6 +14,8 @@
  * @return -3 failed to set accel register
  * @return -4 failed to set gyro register
  * @return -5 failed to dissable fifo
+ * @return -6 failed to wake up the sensor
+ * @return -7 failed to set sample rate divider
  */
 int mpu_initial_setup(i2cBufferType *i2c_buffer_t)
 {
@@ -37,6 +39,9 @@ int mpu_initial_setup(i2cBufferType *i2c_buffer_t)
     if (mpu_wake_up_senzor(i2c_buffer_t) != 0)
         return -6;
 
+    if (mpu_set_sample_rate(i2c_buffer_t) != 0)
+        return -7;
+
     // // Wake up the MPU6050
     // i2c_buffer_t->write_buffer[0] = MPU_PWR_REG; // Power settings register
     // i2c_buffer_t->write_buffer[1] = 0x00;        // wake up signal
@@ -130,6 +135,26 @@ int mpu_set_filter_freq(i2cBufferType *i2c_buffer_t)
     return 0;
 }
 
+/**
+ * @brief Set the MPU sample rate divider to match MPU_SAMPLING_RATE_HZ
+ *
+ * The sample rate defines how often the data registers (and the FIFO buffer) are updated.
+ *
+ * @param i2c_buffer_t: struct with write_buffer, read_buffer
+ * @return 0 OK
+ * @return -1 failed to write the sample rate divider register
+ */
+int mpu_set_sample_rate(i2cBufferType *i2c_buffer_t)
+{
+    i2c_buffer_t->write_buffer[0] = MPU_SMPLRT_DIV_REG; // Sample rate divider register
+    i2c_buffer_t->write_buffer[1] = MPU_SMPLRT_DIV;     // Gyro output rate / (1 + div)
+    if (mpu_transmit(i2c_buffer_t, 2) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
 int mpu_set_accel_fullscale(i2cBufferType *i2c_buffer_t)
 {
     // Set accelerometer full scale range
@@ -276,24 +301,20 @@ void mpu_fifo_reset(i2cBufferType *i2c_buffer_t)
 /**
  * @brief Read FIFO count register and return the value
  *
- * Functions is usefull when we need to check if the FIFO buffer is filled with enough bytes
+ * Functions is usefull when we need to check if the FIFO buffer is filled with enough bytes.
+ * MSB and LSB count registers are subsequent, so both are read in one 2-byte burst.
  *
  * @param i2c_buffer_t: struct with read_buffer, write_buffer
- * @return fifo_count: uint16_t value
+ * @return fifo_count: uint16_t value (0 if the read failed)
  */
 uint16_t mpu_fifo_count(i2cBufferType *i2c_buffer_t)
 {
-    static uint16_t fifo_count;
-    // Read MSB
     i2c_buffer_t->write_buffer[0] = MPU_FIFO_COUNT_H_REG;
-    mpu_transmit_receive(i2c_buffer_t, 1, 1);
-    fifo_count = (i2c_buffer_t->read_buffer[0] << 8);
-    // Read LSB
-    i2c_buffer_t->write_buffer[0] = MPU_FIFO_COUNT_L_REG;
-    mpu_transmit_receive(i2c_buffer_t, 1, 1);
-    fifo_count |= i2c_buffer_t->read_buffer[0];
-
-    return fifo_count;
+    if (mpu_transmit_receive(i2c_buffer_t, 1, 2) != 0)
+    {
+        return 0;
+    }
+    return (i2c_buffer_t->read_buffer[0] << 8) | i2c_buffer_t->read_buffer[1];
 }
 
 /**
@@ -307,7 +328,7 @@ bool mpu_fifo_overflow_check(i2cBufferType *i2c_buffer_t)
 {
     i2c_buffer_t->write_buffer[0] = MPU_FIFO_OVERFLOW;
     mpu_transmit_receive(i2c_buffer_t, 1, 1);
-    if (i2c_buffer_t->read_buffer[0] & 0x10) // check if fifo overflow bit is 1
+    if (i2c_buffer_t->read_buffer[0] & MPU_FIFO_OVERFLOW_MASK) // check if fifo overflow bit is 1
     {
         return true;
     }
@@ -352,6 +373,167 @@ bool mpu_fifo_read_extract(i2cBufferType *i2c_buffer_t, mpuDataType *mpu_data_t)
     return false;
 }
 
+/**
+ * @brief Start streaming data through the FIFO buffer
+ *
+ * Select the FIFO content, then reset and enable the FIFO so the first frame starts at byte 0.
+ * The FIFO is not reset again by mpu_fifo_stream_read unless it overflows.
+ *
+ * @param i2c_buffer_t: struct with write_buffer, read_buffer
+ * @param stream: FIFO stream state
+ * @param fifo_en_mask: FIFO_EN register mask (MPU_FIFO_EN_ACCEL, MPU_FIFO_EN_GYRO_X, ...)
+ * @return 0 OK
+ * @return -1 NULL pointers passed or empty mask
+ * @return -2 failed to write FIFO_EN register
+ * @return -3 failed to reset and enable FIFO
+ */
+int mpu_fifo_stream_start(i2cBufferType *i2c_buffer_t, mpuFifoStreamType *stream, uint8_t fifo_en_mask)
+{
+    if (i2c_buffer_t == NULL || stream == NULL || fifo_en_mask == 0)
+    {
+        return -1;
+    }
+
+    stream->fifo_en_mask = fifo_en_mask;
+    stream->frame_size = 0;
+    stream->frames_read = 0;
+    stream->overflows = 0;
+    if (fifo_en_mask & MPU_FIFO_EN_ACCEL)
+        stream->frame_size += 6;
+    if (fifo_en_mask & MPU_FIFO_EN_TEMP)
+        stream->frame_size += 2;
+    if (fifo_en_mask & MPU_FIFO_EN_GYRO_X)
+        stream->frame_size += 2;
+    if (fifo_en_mask & MPU_FIFO_EN_GYRO_Y)
+        stream->frame_size += 2;
+    if (fifo_en_mask & MPU_FIFO_EN_GYRO_Z)
+        stream->frame_size += 2;
+
+    i2c_buffer_t->write_buffer[0] = MPU_FIFO_EN_REG;
+    i2c_buffer_t->write_buffer[1] = fifo_en_mask;
+    if (mpu_transmit(i2c_buffer_t, 2) != 0)
+    {
+        return -2;
+    }
+    i2c_buffer_t->write_buffer[0] = MPU_USER_CTRL_REG;
+    i2c_buffer_t->write_buffer[1] = MPU_FIFO_RESET_MASK;
+    if (mpu_transmit(i2c_buffer_t, 2) != 0)
+    {
+        return -3;
+    }
+    return 0;
+}
+
+/**
+ * @brief Stop streaming data through the FIFO buffer
+ *
+ * @param i2c_buffer_t: struct with write_buffer, read_buffer
+ * @return 0 OK
+ * @return -1 failed to clear FIFO_EN register
+ * @return -2 failed to dissable FIFO
+ */
+int mpu_fifo_stream_stop(i2cBufferType *i2c_buffer_t)
+{
+    i2c_buffer_t->write_buffer[0] = MPU_FIFO_EN_REG;
+    i2c_buffer_t->write_buffer[1] = 0x00;
+    if (mpu_transmit(i2c_buffer_t, 2) != 0)
+    {
+        return -1;
+    }
+    if (mpu_disable_fifo(i2c_buffer_t) != 0)
+    {
+        return -2;
+    }
+    return 0;
+}
+
+/**
+ * @brief Drain whole frames from the FIFO buffer in a single burst read
+ *
+ * FIFO count is read once (2-byte burst), then all complete frames that fit into frames_buffer
+ * are read in one I2C transaction. The overflow flag is only checked when the FIFO is (nearly) full,
+ * on overflow the FIFO is reset because frame alignment is lost.
+ *
+ * @param i2c_buffer_t: struct with write_buffer, read_buffer
+ * @param stream: FIFO stream state set by mpu_fifo_stream_start
+ * @param frames_buffer: caller buffer that receives the raw frames (max_frames * frame_size bytes)
+ * @param max_frames: max number of frames to read
+ * @return >= 0 number of frames read
+ * @return -1 NULL pointers passed or stream not started
+ * @return -2 FIFO overflowed and was reset, samples were lost
+ * @return -3 failed to read FIFO data
+ */
+int mpu_fifo_stream_read(i2cBufferType *i2c_buffer_t, mpuFifoStreamType *stream, uint8_t *frames_buffer, size_t max_frames)
+{
+    const char *TAG = "MPU FIFO STREAM READ";
+    if (i2c_buffer_t == NULL || stream == NULL || frames_buffer == NULL || stream->frame_size == 0)
+    {
+        return -1;
+    }
+
+    uint16_t fifo_count = mpu_fifo_count(i2c_buffer_t);
+    if (fifo_count > MPU_FIFO_MAX_BYTES - stream->frame_size && mpu_fifo_overflow_check(i2c_buffer_t))
+    {
+        ESP_LOGW(TAG, "FIFO overflow (%u B), resetting", fifo_count);
+        mpu_fifo_reset(i2c_buffer_t);
+        stream->overflows++;
+        return -2;
+    }
+
+    size_t n_frames = fifo_count / stream->frame_size;
+    if (n_frames > max_frames)
+        n_frames = max_frames;
+    if (n_frames == 0)
+        return 0;
+
+    i2c_buffer_t->write_buffer[0] = MPU_FIFO_DATA_REG;
+    if (i2c_master_transmit_receive(i2c_master_dev_handle, i2c_buffer_t->write_buffer, 1, frames_buffer, n_frames * stream->frame_size, I2C_TIMEOUT_MS) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to read %u FIFO frames", n_frames);
+        return -3;
+    }
+    stream->frames_read += n_frames;
+    return n_frames;
+}
+
+/**
+ * @brief Extract one FIFO frame into mpu_data_t.accel_gyro_raw
+ *
+ * Frame content follows the register order: accel X, Y, Z, temp, gyro X, Y, Z.
+ * Channels missing from the frame are left unchanged.
+ *
+ * @param stream: FIFO stream state that defines the frame content
+ * @param frame: pointer to the first byte of the frame
+ * @param mpu_data_t: struct with accel_gyro_raw
+ */
+void mpu_fifo_stream_extract_frame(const mpuFifoStreamType *stream, const uint8_t *frame, mpuDataType *mpu_data_t)
+{
+    int msb = 0;
+    if (stream->fifo_en_mask & MPU_FIFO_EN_ACCEL)
+    {
+        for (int i = 0; i < 3; ++i, msb += 2)
+        {
+            mpu_data_t->accel_gyro_raw[i] = (frame[msb] << 8) | frame[msb + 1];
+        }
+    }
+    if (stream->fifo_en_mask & MPU_FIFO_EN_TEMP)
+        msb += 2;
+    if (stream->fifo_en_mask & MPU_FIFO_EN_GYRO_X)
+    {
+        mpu_data_t->accel_gyro_raw[3] = (frame[msb] << 8) | frame[msb + 1];
+        msb += 2;
+    }
+    if (stream->fifo_en_mask & MPU_FIFO_EN_GYRO_Y)
+    {
+        mpu_data_t->accel_gyro_raw[4] = (frame[msb] << 8) | frame[msb + 1];
+        msb += 2;
+    }
+    if (stream->fifo_en_mask & MPU_FIFO_EN_GYRO_Z)
+    {
+        mpu_data_t->accel_gyro_raw[5] = (frame[msb] << 8) | frame[msb + 1];
+    }
+}
+
 /**
  * @brief Read and extract accel and gyro data directly from sencor registers (not from fifo)
  *
@@ -683,9 +865,7 @@ void mpu_avg_err_divide(mpuDataType *mpu_data_t, uint16_t divisor)
  */
 void mpu_data_substract_err(mpuDataType *mpu_data_t, bool accel_only)
 {
-    static uint8_t i_limit = 6;
-    if (accel_only)
-        i_limit = 3;
+    uint8_t i_limit = accel_only ? 3 : 6;
     for (int i = 0; i < i_limit; ++i)
     {
         int32_t temp = (int32_t)mpu_data_t->accel_gyro_raw[i] - (int32_t)mpu_data_t->avg_err[i];
@@ -12,6 +12,7 @@
 int mpu_initial_setup(i2cBufferType *);
 int mpu_wake_up_senzor(i2cBufferType *);
 int mpu_set_filter_freq(i2cBufferType *);
+int mpu_set_sample_rate(i2cBufferType *);
 int mpu_wake_up_senzor(i2cBufferType *);
 int mpu_set_accel_fullscale(i2cBufferType *);
 int mpu_set_gyro_fullscale(i2cBufferType *);
@@ -24,6 +25,10 @@ uint16_t mpu_fifo_count(i2cBufferType *);
 bool mpu_fifo_overflow_check(i2cBufferType *);
 bool mpu_fifo_read_extract(i2cBufferType *, mpuDataType *);
 void mpu_fifo_extract_buffer(i2cBufferType *, mpuDataType *);
+int mpu_fifo_stream_start(i2cBufferType *, mpuFifoStreamType *, uint8_t);
+int mpu_fifo_stream_stop(i2cBufferType *);
+int mpu_fifo_stream_read(i2cBufferType *, mpuFifoStreamType *, uint8_t *, size_t);
+void mpu_fifo_stream_extract_frame(const mpuFifoStreamType *, const uint8_t *, mpuDataType *);
 void mpu_data_to_fs(mpuDataType *mpu_data_t, bool accel_only);
 bool mpu_calibrate(i2cBufferType*, mpuDataType *, uint8_t, bool);
 void mpu_data_substract_err(mpuDataType *mpu_data_t, bool accel_only);
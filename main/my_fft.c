@@ -1,33 +1,667 @@
 #include "my_fft.h"
 
+// cos(2*pi*i/N_SAMPLES) for i = 0..N_SAMPLES/4, used by the real input split step and the
+// dual core combine stage (sin is read mirrored)
+static float *fft_real_cos_table = NULL;
+
+// Reusable UART frame of fft_send_ms_components_over_uart and fft_send_peaks_over_uart
+// (a packed payload is never longer than a raw one)
+static uint8_t fft_frame_buffer[(FFT_FRAME_SIZE(FFT_MS_MAX_COMPONENTS) > FFT_PEAKS_FRAME_SIZE) ? FFT_FRAME_SIZE(FFT_MS_MAX_COMPONENTS) : FFT_PEAKS_FRAME_SIZE];
+
+// Active spectrum path and the lazily initialised sc16 tables
+static fft_mode_type fft_mode = FFT_MODE_FC32;
+static bool fft_sc16_initialized = false;
+
+static int fft_backend_dsp2r_init(uint32_t max_points);
+static void fft_backend_dsp2r_deinit(void);
+static int fft_backend_dsp2r_transform(float *data, uint32_t n_points);
+static int fft_backend_dsp4r_init(uint32_t max_points);
+static void fft_backend_dsp4r_deinit(void);
+static int fft_backend_dsp4r_transform(float *data, uint32_t n_points);
+
+// Available complex FFT backends, esp-dsp picks its chip optimised kernels (aes3 on the S3) behind these calls
+static const fftBackendType fft_backends[] = {
+    {.name = "ansi", .radix = 2, .init = fft_ansi_init, .deinit = fft_ansi_deinit, .transform = fft_ansi_fc32},
+    {.name = "dsp2r", .radix = 2, .init = fft_backend_dsp2r_init, .deinit = fft_backend_dsp2r_deinit, .transform = fft_backend_dsp2r_transform},
+    {.name = "dsp4r", .radix = 4, .init = fft_backend_dsp4r_init, .deinit = fft_backend_dsp4r_deinit, .transform = fft_backend_dsp4r_transform},
+};
+#define FFT_N_BACKENDS (sizeof(fft_backends) / sizeof(fft_backends[0]))
+#define FFT_BACKEND_FALLBACK 1 // dsp2r, its tables are always initialised and it handles every size
+
+// Backend selected by fft_init for every transform size of a capture length, indexed by log2 of the size in
+// complex points (NULL: dsp2r). Backend tables are built for the largest size and serve every shorter one.
+static const fftBackendType *fft_backend_by_size[32] = {NULL};
+static SemaphoreHandle_t fft_backend_mutex = NULL; // held during transforms and windowing, also serialises the dual core jobs
+
+// Dual core transform: the core 1 worker transforms the odd points while the caller transforms the even points.
+// The caller fills the job, notifies the worker and waits for its notification after every stage.
+static bool fft_dual_core = (FFT_DUAL_CORE == 1);
+static float *fft_split_scratch = NULL;  // FFT_COMPONENTS_SIZE floats, even points then odd points
+static TaskHandle_t fft_split_worker = NULL;
+static TaskHandle_t fft_split_caller = NULL;
+static const fftBackendType *fft_split_backend = NULL;
+static float *fft_split_data = NULL;
+static uint32_t fft_split_points = 0;
+static int fft_split_stage = 0; // 0: deinterleave and transform, 1: combine
+static int fft_split_result = 0;
+
+// Periodic window of length N_SAMPLES divided by its coherent gain, only w[0..N_SAMPLES/2] is stored (w[i] = w[N - i]).
+// The window of a shorter power of 2 length n is w[i * N_SAMPLES / n], so one table serves every transform size.
+// The table and fft_window are only written and read under fft_backend_mutex.
+static float *fft_window_table = NULL;
+static fft_window_type fft_window = FFT_DEFAULT_WINDOW;
+
+// Active payload encoding and the index sorted copy of the components for FFT_ENCODING_PACKED
+static fft_encoding_type fft_encoding = FFT_ENCODING_RAW;
+static indexed_float_type fft_packed_components[FFT_MS_MAX_COMPONENTS];
+static uint32_t fft_packed_indices[FFT_MS_MAX_COMPONENTS];
+static float fft_packed_re_im[2 * FFT_MS_MAX_COMPONENTS];
+
+/**
+ * @brief Fill the window table with a window and remember it as the applied one
+ *
+ * @param window window type
+ */
+static void fft_window_fill_table(fft_window_type window)
+{
+    fft_window_table_fill(fft_window_table, N_SAMPLES, window);
+    fft_window = window;
+}
+
+/**
+ * @brief Window and pack n samples with the applied window (fft_window_pack_raw)
+ *
+ * @param raw_arr raw sensor counts
+ * @param scale physical units per raw count
+ * @param offset added after scaling
+ * @param dst fft array
+ * @param dst_stride 1 for real input packing, 2 for complex input
+ * @param n_samples number of samples (power of 2, <= N_SAMPLES)
+ */
+static void fft_window_pack_all(const int16_t *raw_arr, float scale, float offset, float *dst, uint32_t dst_stride, uint32_t n_samples)
+{
+    // fft_set_window never rewrites the table while a spectrum is windowed
+    xSemaphoreTake(fft_backend_mutex, portMAX_DELAY);
+    fft_window_pack_raw(raw_arr, scale, offset, fft_window_table, N_SAMPLES, dst, dst_stride, n_samples);
+    xSemaphoreGive(fft_backend_mutex);
+}
+
+static int fft_backend_dsp2r_init(uint32_t max_points)
+{
+    return 0; // Initialised by fft_init for the sc16 independent fc32 path
+}
+
+static void fft_backend_dsp2r_deinit(void)
+{
+}
+
+static int fft_backend_dsp2r_transform(float *data, uint32_t n_points)
+{
+    if (dsps_fft2r_fc32(data, n_points) != ESP_OK || dsps_bit_rev_fc32(data, n_points) != ESP_OK)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static int fft_backend_dsp4r_init(uint32_t max_points)
+{
+    return (dsps_fft4r_init_fc32(NULL, max_points) == ESP_OK) ? 0 : -1;
+}
+
+static void fft_backend_dsp4r_deinit(void)
+{
+    dsps_fft4r_deinit_fc32();
+}
+
+static int fft_backend_dsp4r_transform(float *data, uint32_t n_points)
+{
+    if (dsps_fft4r_fc32(data, n_points) != ESP_OK || dsps_bit_rev4r_fc32(data, n_points) != ESP_OK)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Check if a backend can transform n_points (a power of its radix)
+ */
+static inline bool fft_backend_supports(const fftBackendType *backend, uint32_t n_points)
+{
+    uint32_t log2_n = __builtin_ctz(n_points);
+    return backend->radix == 2 || (log2_n % 2) == 0;
+}
+
+/**
+ * @brief Fill n_points complex points with two tones and deterministic pseudo random noise
+ */
+static void fft_backend_test_signal(float *complex_arr, uint32_t n_points)
+{
+    uint32_t lcg = 12345;
+    for (uint32_t i = 0; i < 2 * n_points; i++)
+    {
+        lcg = lcg * 1664525 + 1013904223;
+        complex_arr[i] = (float)sin(2 * M_PI * 37.3 * i / n_points) + 0.25f * (float)cos(2 * M_PI * 1001.0 * i / n_points) +
+                         (float)(lcg >> 8) / (1 << 24) - 0.5f;
+    }
+}
+
+/**
+ * @brief Get the backend selected for a transform size
+ *
+ * @param n_points transform size in complex points (power of 2)
+ * @return backend, dsp2r for sizes without a selection
+ */
+static inline const fftBackendType *fft_backend_lookup(uint32_t n_points)
+{
+    const fftBackendType *backend = fft_backend_by_size[__builtin_ctz(n_points)];
+    return (backend != NULL && fft_backend_supports(backend, n_points)) ? backend : &fft_backends[FFT_BACKEND_FALLBACK];
+}
+
+/**
+ * @brief Verify the initialised FFT backends against the ANSI reference for one size and pick the fastest correct one
+ *
+ * A deterministic test signal is transformed by the reference and by every available backend that supports
+ * n_points. Backends with an error above FFT_BACKEND_TOLERANCE (relative to the reference peak)
+ * are rejected, the others are timed over FFT_BACKEND_BENCH_RUNS transforms.
+ *
+ * @param n_points transform size in complex points
+ * @param reference_arr scratch array of 2 * n_points floats for the reference result
+ * @param test_arr scratch array of 2 * n_points floats
+ * @param available backends whose tables are initialised
+ * @return index of the selected backend (FFT_BACKEND_FALLBACK if nothing else verifies)
+ */
+static int fft_backend_select_size(uint32_t n_points, float *reference_arr, float *test_arr, const bool *available)
+{
+    const char *TAG = "fft_backend_select_size";
+    int error_code = 0;
+
+    fft_backend_test_signal(reference_arr, n_points);
+    fft_ansi_fc32(reference_arr, n_points);
+
+    float peak = 0.0f;
+    for (uint32_t i = 0; i < 2 * n_points; i++)
+    {
+        if (fabsf(reference_arr[i]) > peak)
+            peak = fabsf(reference_arr[i]);
+    }
+
+    int64_t best_us = INT64_MAX;
+    int best = FFT_BACKEND_FALLBACK;
+    for (int b = 0; b < (int)FFT_N_BACKENDS; b++)
+    {
+        const fftBackendType *backend = &fft_backends[b];
+        if (!available[b] || !fft_backend_supports(backend, n_points))
+        {
+            continue;
+        }
+
+        fft_backend_test_signal(test_arr, n_points);
+        float max_error = INFINITY;
+        if ((error_code = backend->transform(test_arr, n_points)) == 0)
+        {
+            max_error = 0.0f;
+            for (uint32_t i = 0; i < 2 * n_points; i++)
+            {
+                float error = fabsf(test_arr[i] - reference_arr[i]);
+                if (error > max_error)
+                    max_error = error;
+            }
+        }
+        if (!(max_error <= FFT_BACKEND_TOLERANCE * peak))
+        {
+            ESP_LOGW(TAG, "%s: rejected for %lu points, error %d, max error %g", backend->name, (unsigned long)n_points, error_code, max_error);
+            continue;
+        }
+
+        // Timed runs on the transformed data, the content does not change the run time
+        int64_t start_us = esp_timer_get_time();
+        for (int run = 0; run < FFT_BACKEND_BENCH_RUNS; run++)
+        {
+            backend->transform(test_arr, n_points);
+        }
+        int64_t run_us = (esp_timer_get_time() - start_us) / FFT_BACKEND_BENCH_RUNS;
+        ESP_LOGI(TAG, "%s: %lld us per %lu point transform, max error %g", backend->name, run_us, (unsigned long)n_points, max_error);
+
+        if (run_us < best_us)
+        {
+            best_us = run_us;
+            best = b;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Select the FFT backend of every capture length once at boot
+ *
+ * Every backend is initialised for the largest transform and fft_backend_select_size picks the fastest
+ * correct one for each size from CAPTURE_MIN_SAMPLES to N_SAMPLES (radix-4 only handles every other size
+ * and the fastest backend depends on the size). Tables of the backends that no size selected are released,
+ * so fft_calculate_re_im only looks the backend up.
+ *
+ * @return 0 OK (dsp2r is kept for sizes where nothing else verifies)
+ * @return -1 failed to allocate the test buffers or to init the reference
+ */
+static int fft_backend_autoselect(void)
+{
+    const char *TAG = "fft_backend_autoselect";
+    size_t buffer_size = FFT_COMPONENTS_SIZE * sizeof(float);
+    float *reference_arr = (float *)heap_caps_malloc(buffer_size, MALLOC_CAP_SPIRAM);
+    float *test_arr = (float *)heap_caps_aligned_alloc(16, buffer_size, MALLOC_CAP_SPIRAM);
+    bool available[FFT_N_BACKENDS] = {false};
+    bool selected[FFT_N_BACKENDS] = {false};
+
+    if (reference_arr == NULL || test_arr == NULL || fft_ansi_init(FFT_COMPONENTS_SIZE / 2) != 0)
+    {
+        heap_caps_free(reference_arr);
+        heap_caps_free(test_arr);
+        return -1;
+    }
+
+    for (int b = 0; b < (int)FFT_N_BACKENDS; b++)
+    {
+        available[b] = (fft_backends[b].init(FFT_COMPONENTS_SIZE / 2) == 0);
+        if (!available[b])
+            ESP_LOGI(TAG, "%s: not available", fft_backends[b].name);
+    }
+    available[FFT_BACKEND_FALLBACK] = true;
+    selected[FFT_BACKEND_FALLBACK] = true;
+
+    for (uint32_t n_samples = CAPTURE_MIN_SAMPLES; n_samples <= N_SAMPLES; n_samples *= 2)
+    {
+        uint32_t n_points = FFT_COMPONENTS_LEN(n_samples) / 2;
+        int best = fft_backend_select_size(n_points, reference_arr, test_arr, available);
+        fft_backend_by_size[__builtin_ctz(n_points)] = &fft_backends[best];
+        selected[best] = true;
+        ESP_LOGI(TAG, "N=%lu: selected %s", (unsigned long)n_samples, fft_backends[best].name);
+    }
+
+    for (int b = 0; b < (int)FFT_N_BACKENDS; b++)
+    {
+        if (available[b] && !selected[b])
+            fft_backends[b].deinit();
+    }
+    heap_caps_free(reference_arr);
+    heap_caps_free(test_arr);
+    return 0;
+}
+
+/**
+ * @brief cos and sin of 2*pi*a/N_SAMPLES for 0 <= a <= N_SAMPLES/2 from the quarter wave table
+ */
+static inline void fft_split_twiddle(uint32_t a, float *c, float *s)
+{
+    const uint32_t quarter = N_SAMPLES / 4;
+    if (a <= quarter)
+    {
+        *c = fft_real_cos_table[a];
+        *s = fft_real_cos_table[quarter - a];
+    }
+    else
+    {
+        *c = -fft_real_cos_table[N_SAMPLES / 2 - a];
+        *s = fft_real_cos_table[a - quarter];
+    }
+}
+
+/**
+ * @brief Run one half of a stage of the dual core transform
+ *
+ * Stage 0 (decimation in time): half 0 copies the even points of the data to the front of the
+ * scratch array, half 1 the odd points to the back, each half is transformed in place.
+ * Stage 1: X[k] = E[k] + W^k O[k] and X[k + n/2] = E[k] - W^k O[k] is written back to the data,
+ * half 0 for k < n/4, half 1 for the rest.
+ *
+ * @param part 0 for the calling core, 1 for the worker
+ * @return 0 OK, backend error code otherwise
+ */
+static int fft_split_run(uint32_t part)
+{
+    uint32_t n_points = fft_split_points;
+    uint32_t half = n_points / 2;
+    const float *src = fft_split_data;
+    float *sub = &fft_split_scratch[2 * half * part];
+
+    if (fft_split_stage == 0)
+    {
+        for (uint32_t i = 0; i < half; i++)
+        {
+            sub[2 * i] = src[4 * i + 2 * part];
+            sub[2 * i + 1] = src[4 * i + 2 * part + 1];
+        }
+        return fft_split_backend->transform(sub, half);
+    }
+
+    const float *even = fft_split_scratch;
+    const float *odd = &fft_split_scratch[2 * half];
+    float *dst = fft_split_data;
+    uint32_t stride = N_SAMPLES / n_points; // twiddle table is built for N_SAMPLES
+    uint32_t end = (part == 0) ? half / 2 : half;
+    for (uint32_t k = (part == 0) ? 0 : half / 2; k < end; k++)
+    {
+        float c, s;
+        fft_split_twiddle(k * stride, &c, &s);
+        // W^k * O[k] with W^k = c - j*s
+        float t_re = c * odd[2 * k] + s * odd[2 * k + 1];
+        float t_im = c * odd[2 * k + 1] - s * odd[2 * k];
+        dst[2 * k] = even[2 * k] + t_re;
+        dst[2 * k + 1] = even[2 * k + 1] + t_im;
+        dst[2 * (k + half)] = even[2 * k] - t_re;
+        dst[2 * (k + half) + 1] = even[2 * k + 1] - t_im;
+    }
+    return 0;
+}
+
+/**
+ * @brief Core 1 half of the dual core transform, runs one stage per notification
+ */
+static void fft_split_worker_task(void *params)
+{
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        fft_split_result = fft_split_run(1);
+        xTaskNotifyGive(fft_split_caller);
+    }
+}
+
+/**
+ * @brief Transform n_points complex points on both cores
+ *
+ * The transform is split into the n/2 point transforms of the even and the odd points
+ * (decimation in time), one per core, and combined with a final radix-2 butterfly stage
+ * that is split between the cores as well. The calling task waits on its own notification
+ * for the worker, so it must not be notified by anything else during the call.
+ * The caller must hold fft_backend_mutex, so the worker only ever runs one job.
+ *
+ * @param complex_arr n_points re, im pairs, overwritten with the natural order result
+ * @param n_points transform size (power of 2, <= FFT_COMPONENTS_SIZE / 2)
+ * @param backend backend for the half size transforms (must support n_points / 2)
+ * @return 0 OK
+ * @return -1 worker not started (caller falls back to one core)
+ * @return -2 backend error
+ */
+static int fft_split_transform(float *complex_arr, uint32_t n_points, const fftBackendType *backend)
+{
+    if (fft_split_worker == NULL)
+    {
+        return -1;
+    }
+    fft_split_caller = xTaskGetCurrentTaskHandle();
+    fft_split_backend = backend;
+    fft_split_data = complex_arr;
+    fft_split_points = n_points;
+
+    int error_code = 0;
+    for (fft_split_stage = 0; fft_split_stage < 2; fft_split_stage++)
+    {
+        xTaskNotifyGive(fft_split_worker);
+        int own_result = fft_split_run(0);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (own_result != 0 || fft_split_result != 0)
+        {
+            error_code = -2;
+            break;
+        }
+    }
+    return error_code;
+}
+
+/**
+ * @brief Allocate the scratch array of the dual core transform and start its worker on core 1
+ *
+ * The FFT task runs the other half pinned to core 0. The worker shares core 1 with the sampling task,
+ * which has the higher priority, so sampling preempts the worker and never waits for a transform.
+ *
+ * @return 0 OK
+ * @return -1 failed to allocate the scratch array
+ * @return -2 failed to create the worker task
+ */
+static int fft_split_init(void)
+{
+    fft_split_scratch = (float *)heap_caps_aligned_alloc(16, FFT_COMPONENTS_SIZE * sizeof(float), MALLOC_CAP_SPIRAM);
+    if (fft_split_scratch == NULL)
+    {
+        return -1;
+    }
+    if (xTaskCreatePinnedToCore(fft_split_worker_task, "FFT worker task", TASK_FFT_WORKER_STACK_SIZE, NULL, 10, &fft_split_worker, APP_CPU_NUM) != pdPASS)
+    {
+        fft_split_worker = NULL;
+        return -2;
+    }
+    return 0;
+}
+
 /**
  * @brief Perform dsps fft init process
  *
+ * With FFT_REAL_INPUT the esp-dsp tables are initialised for the half size transform
+ * and the quarter wave cosine table of the real input split step is prepared.
+ * With FFT_BACKEND_AUTOSELECT the fastest verified complex FFT backend is selected for every capture length.
+ * With FFT_DUAL_CORE the scratch array and the core 1 worker of the dual core transform are set up.
+ * The window table is allocated in internal RAM (PSRAM if that fails) and filled with FFT_DEFAULT_WINDOW.
+ *
  * @return 0 OK
  * @return -1 fft init error
+ * @return -2 failed to allocate real input cosine table
+ * @return -3 failed to allocate window table
+ * @return -4 failed to start the dual core FFT worker
+ * @return -5 failed to create the backend mutex
  */
 int fft_init()
 {
     const char *TAG = "fft_init";
     int error_code = 0;
 
+#if FFT_REAL_INPUT == 1
+    if ((error_code = dsps_fft2r_init_fc32(NULL, N_SAMPLES / 2)) != 0)
+    {
+        ESP_LOGE(TAG, "FFT init error_code: %d", error_code);
+        return -1;
+    }
+#else
     if ((error_code = dsps_fft2r_init_fc32(NULL, N_SAMPLES)) != 0)
     {
         ESP_LOGE(TAG, "FFT init error_code: %d", error_code);
         return -1;
     }
+#endif
+
+#if FFT_REAL_INPUT == 1 || FFT_DUAL_CORE == 1
+    size_t table_size = (N_SAMPLES / 4 + 1) * sizeof(float);
+    fft_real_cos_table = (float *)heap_caps_malloc(table_size, MALLOC_CAP_INTERNAL);
+    if (fft_real_cos_table == NULL)
+        fft_real_cos_table = (float *)heap_caps_malloc(table_size, MALLOC_CAP_SPIRAM);
+    if (fft_real_cos_table == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to allocate real input cosine table");
+        return -2;
+    }
+    fft_real_cos_table_fill(fft_real_cos_table, N_SAMPLES);
+#endif
+
+    fft_backend_mutex = xSemaphoreCreateMutex();
+    if (fft_backend_mutex == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to create backend mutex");
+        return -5;
+    }
+
+#if FFT_BACKEND_AUTOSELECT == 1
+    if (fft_backend_autoselect() != 0)
+    {
+        ESP_LOGW(TAG, "FFT backend selection failed, using %s", fft_backends[FFT_BACKEND_FALLBACK].name);
+    }
+#endif
+
+    size_t window_size = (N_SAMPLES / 2 + 1) * sizeof(float);
+    fft_window_table = (float *)heap_caps_malloc(window_size, MALLOC_CAP_INTERNAL);
+    if (fft_window_table == NULL)
+        fft_window_table = (float *)heap_caps_malloc(window_size, MALLOC_CAP_SPIRAM);
+    if (fft_window_table == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to allocate window table");
+        return -3;
+    }
+    fft_window_fill_table(fft_window);
+
+#if FFT_DUAL_CORE == 1
+    if ((error_code = fft_split_init()) != 0)
+    {
+        ESP_LOGE(TAG, "Failed to start dual core FFT worker: %d", error_code);
+        return -4;
+    }
+#endif
+    return 0;
+}
+
+/**
+ * @brief Select the spectrum calculation path
+ *
+ * The esp-dsp sc16 tables are only initialised on the first switch to FFT_MODE_SC16,
+ * so the fc32 only firmware does not pay for them.
+ *
+ * @param mode FFT_MODE_FC32 or FFT_MODE_SC16
+ * @return 0 OK
+ * @return -1 invalid mode
+ * @return -2 sc16 fft init error
+ */
+int fft_set_mode(fft_mode_type mode)
+{
+    const char *TAG = "fft_set_mode";
+    int error_code = 0;
+
+    if (mode != FFT_MODE_FC32 && mode != FFT_MODE_SC16)
+    {
+        return -1;
+    }
+    if (mode == FFT_MODE_SC16 && !fft_sc16_initialized)
+    {
+        if ((error_code = dsps_fft2r_init_sc16(NULL, N_SAMPLES)) != 0)
+        {
+            ESP_LOGE(TAG, "FFT sc16 init error_code: %d", error_code);
+            return -2;
+        }
+        fft_sc16_initialized = true;
+    }
+    fft_mode = mode;
+    return 0;
+}
+
+/**
+ * @brief Get the active spectrum calculation path
+ *
+ * @return fft_mode_type
+ */
+fft_mode_type fft_get_mode(void)
+{
+    return fft_mode;
+}
+
+/**
+ * @brief Select the payload encoding of the FFT results
+ *
+ * FFT_ENCODING_PEAKS only changes fc32 results, sc16 results are still sent as ranked components.
+ *
+ * @param encoding FFT_ENCODING_RAW, FFT_ENCODING_PACKED or FFT_ENCODING_PEAKS
+ * @return 0 OK
+ * @return -1 invalid encoding
+ */
+int fft_set_encoding(fft_encoding_type encoding)
+{
+    if (encoding != FFT_ENCODING_RAW && encoding != FFT_ENCODING_PACKED && encoding != FFT_ENCODING_PEAKS)
+    {
+        return -1;
+    }
+    fft_encoding = encoding;
+    return 0;
+}
+
+/**
+ * @brief Get the active payload encoding of the FFT results
+ *
+ * @return fft_encoding_type
+ */
+fft_encoding_type fft_get_encoding(void)
+{
+    return fft_encoding;
+}
+
+/**
+ * @brief Get the name of the complex FFT backend fft_init selected for a number of samples
+ *
+ * @param n_samples number of data samples (power of 2, <= N_SAMPLES)
+ * @return backend name
+ */
+const char *fft_get_backend_name(uint32_t n_samples)
+{
+    return fft_backend_lookup(FFT_COMPONENTS_LEN(n_samples) / 2)->name;
+}
+
+/**
+ * @brief Enable or disable the dual core transform of large FFTs
+ *
+ * @param enabled true to split transforms of at least FFT_DUAL_CORE_MIN_POINTS points between both cores
+ * @return 0 OK
+ * @return -1 dual core worker not available (FFT_DUAL_CORE disabled or not started)
+ */
+int fft_set_dual_core(bool enabled)
+{
+    if (enabled && fft_split_worker == NULL)
+    {
+        return -1;
+    }
+    fft_dual_core = enabled;
     return 0;
 }
 
 /**
- * @brief Prepare window before constructing complex array
+ * @brief Check if large FFTs are split between both cores
+ *
+ * @return true if the dual core transform is enabled
+ */
+bool fft_get_dual_core(void)
+{
+    return fft_dual_core && fft_split_worker != NULL;
+}
+
+/**
+ * @brief Select the window applied to the samples before the FFT
  *
- * @param window_arr pointer to the window array
+ * The table is rebuilt here under fft_backend_mutex, so a spectrum that is being windowed keeps its window
+ * and every spectrum prepared after the call uses the new one.
  *
+ * @param window fft_window_type
+ * @return 0 OK
+ * @return -1 invalid window
+ */
+int fft_set_window(fft_window_type window)
+{
+    if (window < FFT_WINDOW_RECT || window > FFT_WINDOW_FLAT_TOP)
+    {
+        return -1;
+    }
+    xSemaphoreTake(fft_backend_mutex, portMAX_DELAY);
+    if (window != fft_window)
+    {
+        fft_window_fill_table(window);
+    }
+    xSemaphoreGive(fft_backend_mutex);
+    return 0;
+}
+
+/**
+ * @brief Get the window the window table holds
+ *
+ * @return fft_window_type
  */
-void fft_prepare_window(float *window_arr)
+fft_window_type fft_get_window(void)
 {
-    dsps_wind_hann_f32(window_arr, N_SAMPLES);
+    xSemaphoreTake(fft_backend_mutex, portMAX_DELAY);
+    fft_window_type window = fft_window;
+    xSemaphoreGive(fft_backend_mutex);
+    return window;
 }
 
 /**
@@ -46,6 +680,11 @@ void fft_prepare_complex_arr(float *sampled_data_arr, float *complex_arr, uint32
         ESP_LOGE(TAG, "Null pointers passed");
         return;
     }
+#if FFT_REAL_INPUT == 1
+    // Even samples become re and odd samples im parts of arr_len/2 complex points,
+    // which is exactly the layout of the sampled data: [x0, x1, x2, x3, ...] = [re0, im0, re1, im1, ...]
+    memcpy(complex_arr, sampled_data_arr, arr_len * sizeof(float));
+#else
     // Prepare fft_complex_arr array
     for (int i = 0; i < arr_len; i++)
     {
@@ -53,24 +692,85 @@ void fft_prepare_complex_arr(float *sampled_data_arr, float *complex_arr, uint32
         complex_arr[2 * i] = sampled_data_arr[i]; // * window_arr[i]; // Real part (@ i-th index)
         complex_arr[2 * i + 1] = 0;               // Imaginary part (@ i + 1 index)
     }
+#endif
+}
+
+/**
+ * @brief Convert raw sensor counts to physical units, window them and fill the complex array
+ *
+ * value = (raw - bias) * scale * w[i], evaluated as (raw * scale + offset) * w[i] in one pass
+ * that is unrolled by 4, so windowing costs one multiply per sample on top of the conversion.
+ *
+ * @param raw_arr: array with raw sensor counts
+ * @param bias: raw count offset subtracted from every sample
+ * @param scale: physical units per raw count
+ * @param complex_arr: array that stores real and imaginary parts of the signal
+ * @param arr_len: length of the raw_arr (power of 2, <= N_SAMPLES)
+ */
+void fft_prepare_complex_arr_raw(const int16_t *raw_arr, float bias, float scale, float *complex_arr, uint32_t arr_len)
+{
+    const char *TAG = "fft_prepare_complex_arr_raw";
+    if (raw_arr == NULL || complex_arr == NULL)
+    {
+        ESP_LOGE(TAG, "Null pointers passed");
+        return;
+    }
+#if FFT_REAL_INPUT == 1
+    // Same packing as fft_prepare_complex_arr: [x0, x1, x2, x3, ...] = [re0, im0, re1, im1, ...]
+    fft_window_pack_all(raw_arr, scale, -bias * scale, complex_arr, 1, arr_len);
+#else
+    fft_window_pack_all(raw_arr, scale, -bias * scale, complex_arr, 2, arr_len);
+#endif
 }
 
 /**
  * @brief Run DFFT and calculate real and imaginary componenty of the signal
  *
  * Calculate re and im parts of the sampled signal
- * and store results into fft_complex_arr array of length N_SAMPLES*2
+ * and store results into fft_complex_arr array of length FFT_COMPONENTS_LEN(n_samples).
+ * In both modes the first n_samples/2 re, im pairs hold bins 0..n_samples/2-1 with the same scaling.
  *
  * @param complex_arr fft complex components array
- * @param n_samples number of data samples (should be half the size of the complex arr)
+ * @param n_samples number of data samples
  */
 void fft_calculate_re_im(float *complex_arr, uint32_t n_samples)
 {
-    ESP_ERROR_CHECK(dsps_fft2r_fc32(complex_arr, n_samples));
+    uint32_t n_points = FFT_COMPONENTS_LEN(n_samples) / 2;
+    // Sizes without a selection (shorter than CAPTURE_MIN_SAMPLES) use esp-dsp radix-2
+    const fftBackendType *backend = fft_backend_lookup(n_points);
+    xSemaphoreTake(fft_backend_mutex, portMAX_DELAY);
 
-    ESP_ERROR_CHECK(dsps_bit_rev_fc32(complex_arr, n_samples));
+    // Large transforms are split between both cores, fft_backend_mutex keeps the worker to one job at a time
+    bool transformed = false;
+    if (fft_get_dual_core() && n_points >= FFT_DUAL_CORE_MIN_POINTS)
+    {
+        const fftBackendType *split_backend = fft_backend_supports(backend, n_points / 2) ? backend : &fft_backends[FFT_BACKEND_FALLBACK];
+        transformed = (fft_split_transform(complex_arr, n_points, split_backend) == 0);
+    }
+    if (!transformed)
+    {
+        ESP_ERROR_CHECK(backend->transform(complex_arr, n_points));
+    }
+    xSemaphoreGive(fft_backend_mutex);
 
+#if FFT_REAL_INPUT == 1
+    fft_real_split(complex_arr, n_samples);
+#else
     ESP_ERROR_CHECK(dsps_cplx2reC_fc32(complex_arr, n_samples));
+#endif
+}
+
+/**
+ * @brief Unpack the spectrum of a real signal from the half size complex FFT of its packed samples
+ *
+ * fft_real_split_table with the quarter wave table built by fft_init for N_SAMPLES.
+ *
+ * @param complex_arr n_samples/2 complex points, overwritten with bins 0..n_samples/2-1
+ * @param n_samples number of real samples (power of 2, <= N_SAMPLES)
+ */
+void fft_real_split(float *complex_arr, uint32_t n_samples)
+{
+    fft_real_split_table(complex_arr, n_samples, fft_real_cos_table, N_SAMPLES);
 }
 
 /**
@@ -97,10 +797,12 @@ void fft_calculate_magnitudes(indexed_float_type *indexed_magnitudes_arr, float
         return;
     }
 
+    // Normalised by the transform size, so windows of different sizes give comparable magnitudes
+    float n_samples = 2.0f * magnitudes_size;
     for (int i = 0; i < magnitudes_size; i++)
     {
         indexed_magnitudes_arr[i].index = i;
-        indexed_magnitudes_arr[i].value = sqrtf(((fft_complex_arr[i * 2] * fft_complex_arr[i * 2]) + (fft_complex_arr[i * 2 + 1] * fft_complex_arr[i * 2 + 1])) / N_SAMPLES);
+        indexed_magnitudes_arr[i].value = sqrtf(((fft_complex_arr[i * 2] * fft_complex_arr[i * 2]) + (fft_complex_arr[i * 2 + 1] * fft_complex_arr[i * 2 + 1])) / n_samples);
     }
 }
 
@@ -115,6 +817,109 @@ void fft_sort_magnitudes(indexed_float_type *indexed_mangitudes, uint32_t magnit
     qsort(indexed_mangitudes, magnitudes_size, sizeof(indexed_float_type), compare_indexed_float_type_descending);
 }
 
+/**
+ * @brief Remove the bias from raw counts, window them and pack them as sc16 complex points with block scaling
+ *
+ * Every radix-2 stage of the sc16 FFT halves the data to avoid overflow, so the whole block is
+ * scaled by 2^shift until its largest windowed sample uses the full int16 range to keep the precision of the result.
+ *
+ * @param raw_arr array with raw sensor counts
+ * @param bias raw count offset subtracted from every sample
+ * @param sc16_arr 4 byte aligned array of 2 * n_samples int16 that receives [re0, im0, re1, im1, ...]
+ * @param n_samples number of samples (power of 2, <= N_SAMPLES)
+ * @return block shift applied to the windowed samples (negative for a right shift)
+ */
+int fft_sc16_prepare(const int16_t *raw_arr, float bias, int16_t *sc16_arr, uint32_t n_samples)
+{
+    // Windowed counts are first written as floats, float i takes the bytes of sc16 pair i
+    float *windowed_arr = (float *)sc16_arr;
+    float max_abs = 0.0f;
+    int shift = 0;
+
+    fft_window_pack_all(raw_arr, 1.0f, -bias, windowed_arr, 1, n_samples);
+    for (uint32_t i = 0; i < n_samples; i++)
+    {
+        float value = fabsf(windowed_arr[i]);
+        if (value > max_abs)
+            max_abs = value;
+    }
+    // Largest shift that keeps the peak inside int16 after rounding
+    if (max_abs > 0.0f)
+    {
+        int exponent;
+        frexpf(max_abs, &exponent);
+        shift = 15 - exponent;
+        if (ldexpf(max_abs, shift) >= INT16_MAX + 0.5f)
+            shift--;
+    }
+    float factor = ldexpf(1.0f, shift);
+
+    for (uint32_t i = 0; i < n_samples; i++)
+    {
+        int16_t value = (int16_t)lrintf(windowed_arr[i] * factor);
+        sc16_arr[2 * i] = value;
+        sc16_arr[2 * i + 1] = 0;
+    }
+    return shift;
+}
+
+/**
+ * @brief Run the fixed point FFT on the block scaled samples
+ *
+ * The result in natural order is the spectrum of the shifted samples divided by n_samples.
+ *
+ * @param sc16_arr sc16 complex array prepared with fft_sc16_prepare
+ * @param n_samples number of samples (power of 2, <= N_SAMPLES)
+ */
+void fft_sc16_calculate_re_im(int16_t *sc16_arr, uint32_t n_samples)
+{
+    ESP_ERROR_CHECK(dsps_fft2r_sc16(sc16_arr, n_samples));
+
+    ESP_ERROR_CHECK(dsps_bit_rev_sc16_ansi(sc16_arr, n_samples));
+}
+
+/**
+ * @brief Convert the sc16 results to the layout and scaling of the fc32 path
+ *
+ * Bins 0..n_samples/2-1 are expanded in place to float re, im pairs scaled like fft_calculate_re_im.
+ * Bins are expanded from the last one down, so a float pair never overwrites an unread sc16 bin.
+ * The first n_top indexed powers become magnitudes scaled like fft_calculate_magnitudes,
+ * the rest of the array keeps the integer powers.
+ *
+ * @param sc16_arr sc16 FFT result, overwritten with n_samples floats
+ * @param indexed_powers powers ranked with fft_sc16_select_top_powers, reused as indexed_float_type
+ * @param n_samples number of samples
+ * @param n_top number of ranked powers to convert
+ * @param shift block shift returned by fft_sc16_prepare
+ * @param scale physical units per raw count
+ */
+void fft_sc16_to_fc32(int16_t *sc16_arr, indexed_uint_type *indexed_powers, uint32_t n_samples, uint32_t n_top, int shift, float scale)
+{
+    float *complex_arr = (float *)sc16_arr;
+    indexed_float_type *indexed_magnitudes = (indexed_float_type *)indexed_powers;
+
+    // X[k] = sc16[k] * n_samples / 2^shift * scale, bins 1..n/2-1 are doubled like dsps_cplx2reC_fc32
+    float bin_scale = ldexpf(scale * n_samples, -shift);
+    for (uint32_t k = n_samples / 2; k-- > 1;)
+    {
+        float re = sc16_arr[2 * k] * (2 * bin_scale);
+        float im = sc16_arr[2 * k + 1] * (2 * bin_scale);
+        complex_arr[2 * k] = re;
+        complex_arr[2 * k + 1] = im;
+    }
+    complex_arr[0] = sc16_arr[0] * bin_scale;
+    complex_arr[1] = 0;
+
+    if (n_top > n_samples / 2)
+        n_top = n_samples / 2;
+    for (uint32_t i = 0; i < n_top; i++)
+    {
+        uint32_t power = indexed_powers[i].value;
+        float bin_factor = (indexed_powers[i].index == 0) ? bin_scale : (2 * bin_scale);
+        indexed_magnitudes[i].value = bin_factor * sqrtf((float)power / n_samples);
+    }
+}
+
 /**
  * @brief Debug plot the magnitudes of the magnitudes_indexed
  *
@@ -154,18 +959,17 @@ int compare_indexed_float_type_descending(const void *a, const void *b)
 }
 
 /**
- * @brief Calculate how many elements to print out depending on the percentile
+ * @brief Compare indexed_float_type structs by index in ascending order
  *
- * If we have an array of size 100, then 95th percentile index is i = 95,
- * therefore in a sorted array first (100-95)=5 elements are 95th percentile.
- *
- * @param percentile: 0 <= float < 100
- * @param arr_len: array length
- * @return uint32_t
+ * @param a: value a
+ * @param b: value b
+ * @return int: -1 if a < b, 1 if a > b, 0 if a == b
  */
-uint32_t fft_percentile_n_components(float percentile, uint32_t arr_len)
+int compare_indexed_float_type_index_ascending(const void *a, const void *b)
 {
-    return arr_len - ((percentile / 100) * arr_len);
+    uint32_t ia = ((const indexed_float_type *)a)->index;
+    uint32_t ib = ((const indexed_float_type *)b)->index;
+    return (ia > ib) - (ia < ib);
 }
 
 /**
@@ -251,7 +1055,7 @@ int fft_prepare_complex_buffer(uint8_t *complex_buffer, size_t complex_size, uin
     for (uint32_t i = 0; i < n_ms_components; i++)
     {
         uint32_t mag_index = indexed_mangitudes[i].index * 2;
-        if (mag_index >= N_SAMPLES * 2)
+        if (mag_index >= FFT_COMPONENTS_SIZE)
         {
             return -3;
         }
@@ -265,153 +1069,274 @@ int fft_prepare_complex_buffer(uint8_t *complex_buffer, size_t complex_size, uin
 }
 
 /**
- * @brief Send the first n components (magnitude, re, im) of DFFT calculation
+ * @brief Prepare the metadata block that starts every FFT result payload
+ *
+ * u32 n_samples | u32 n_components | u32 sample_rate_hz | u8 source | u8 channel | u16 reserved
+ *
+ * @param metadata_buffer buffer that receives the metadata
+ * @param metadata_size size of metadata_buffer
+ * @param info transform size, sampling rate, source and channel of the result
+ * @param n_components number of components in the payload
+ * @return 0 OK
+ * @return -1 null pointer passed
+ * @return -2 metadata buffer size too small
+ */
+static int fft_prepare_result_metadata(uint8_t *metadata_buffer, size_t metadata_size, const fftResultInfoType *info, uint32_t n_components)
+{
+    int error_code = 0;
+    if ((error_code = fft_prepare_metadata_buffer(metadata_buffer, metadata_size, info->n_samples, n_components)) != 0)
+    {
+        return error_code;
+    }
+    if (metadata_size < FFT_FRAME_METADATA_SIZE)
+    {
+        return -2;
+    }
+    memcpy(&metadata_buffer[2 * sizeof(uint32_t)], &info->sample_rate_hz, sizeof(uint32_t));
+    metadata_buffer[12] = info->source;
+    metadata_buffer[13] = info->channel;
+    metadata_buffer[14] = 0;
+    metadata_buffer[15] = 0;
+    return 0;
+}
+
+/**
+ * @brief Send the first n components (re, im) of DFFT calculation as one FFT_COMPONENTS or FFT_PACKED frame
+ *
+ * The payload is encoded directly into the preallocated fft_frame_buffer behind the frame header,
+ * the header and CRC are added by uart_frame_send_buffer and the frame is sent in one write.
  *
  * @param fft_complex_arr fft complex components array (re, im elements)
  * @param indexed_magnitudes indexed magnitudes array
- * @param n_samples number of data samples
+ * @param info transform size, sampling rate, source and channel of the result
  * @param n_ms_elements number of most significant elements
  * @return 0 OK
- * @return -1 failed to malloc metadata buffer
- * @return -3 failed to malloc indices buffer
- * @return -5 failed to malloc complex buffer
- * @return -2 failed to prepare metadata buffer
- * @return -6 failed to prepare indices buffer
- * @return - failed to prepare complex buffer
- * @return -7 failed to UART write buffers
- * @return -8 failed to debug UART buffers
+ * @return -1 failed to encode the payload
+ * @return -2 failed to send the frame
  */
-int fft_send_ms_components_over_uart(float *fft_complex_arr, indexed_float_type *indexed_magnitudes, uint32_t n_samples, uint32_t n_ms_elements)
+int fft_send_ms_components_over_uart(float *fft_complex_arr, indexed_float_type *indexed_magnitudes, const fftResultInfoType *info, uint32_t n_ms_elements)
 {
     const char *TAG = "fft_send_ms_components_over_uart";
     int error_code = 0;
-    uint8_t *metadata_buffer = NULL;
-    uint8_t *indices_buffer = NULL;
-    uint8_t *complex_buffer = NULL;
 
-    // Metadata buffer
-    size_t metadata_size = 2 * sizeof(uint32_t);
-    metadata_buffer = (uint8_t *)malloc(metadata_size);
-    if (metadata_buffer == NULL)
+    int payload_len = 0;
+    uint8_t frame_type = UART_FRAME_TYPE_FFT_COMPONENTS;
+
+    if (fft_encoding == FFT_ENCODING_PACKED)
     {
-        error_code = -1;
-        goto memcleanup;
+        frame_type = UART_FRAME_TYPE_FFT_PACKED;
+        payload_len = fft_encode_packed_frame(&fft_frame_buffer[UART_FRAME_HEADER_SIZE], sizeof(fft_frame_buffer) - UART_FRAME_OVERHEAD,
+                                              fft_complex_arr, indexed_magnitudes, info, n_ms_elements);
+    }
+    else
+    {
+        payload_len = fft_encode_frame(&fft_frame_buffer[UART_FRAME_HEADER_SIZE], sizeof(fft_frame_buffer) - UART_FRAME_OVERHEAD,
+                                       fft_complex_arr, indexed_magnitudes, info, n_ms_elements);
+    }
+    if (payload_len < 0)
+    {
+        ESP_LOGE(TAG, "error -1, sub error %d", payload_len);
+        return -1;
+    }
+    if ((error_code = uart_frame_send_buffer(fft_frame_buffer, sizeof(fft_frame_buffer), frame_type, payload_len)) != 0)
+    {
+        ESP_LOGE(TAG, "error -2, sub error %d", error_code);
+        return -2;
     }
+    return 0;
+}
 
-    // Most significant indices buffer
-    size_t indices_size = n_ms_elements * sizeof(uint32_t);
-    indices_buffer = (uint8_t *)malloc(indices_size);
-    if (indices_buffer == NULL)
+/**
+ * @brief Send a peak list as one FFT_PEAKS frame
+ *
+ * @param peak_list peaks found by fft_peaks_find
+ * @param info transform size, sampling rate, source and channel of the result
+ * @return 0 OK
+ * @return -1 failed to encode the payload
+ * @return -2 failed to send the frame
+ */
+int fft_send_peaks_over_uart(const fftPeakListType *peak_list, const fftResultInfoType *info)
+{
+    const char *TAG = "fft_send_peaks_over_uart";
+    int error_code = 0;
+
+    int payload_len = fft_encode_peaks_frame(&fft_frame_buffer[UART_FRAME_HEADER_SIZE], sizeof(fft_frame_buffer) - UART_FRAME_OVERHEAD, peak_list, info);
+    if (payload_len < 0)
     {
-        error_code = -2;
-        goto memcleanup;
+        ESP_LOGE(TAG, "error -1, sub error %d", payload_len);
+        return -1;
+    }
+    if ((error_code = uart_frame_send_buffer(fft_frame_buffer, sizeof(fft_frame_buffer), UART_FRAME_TYPE_FFT_PEAKS, payload_len)) != 0)
+    {
+        ESP_LOGE(TAG, "error -2, sub error %d", error_code);
+        return -2;
     }
+    return 0;
+}
 
-    // Complex data buffer
-    size_t complex_size = 2 * n_ms_elements * sizeof(float);
-    complex_buffer = (uint8_t *)malloc(complex_size);
-    if (complex_buffer == NULL)
+/**
+ * @brief Encode the payload of an FFT_PEAKS frame
+ *
+ * Payload layout (little endian):
+ * u32 n_samples | u32 n_peaks | u32 sample_rate_hz | u8 source | u8 channel | u16 reserved
+ * f32 noise_floor
+ * f32 freq_hz, amplitude pairs[n_peaks], strongest first
+ *
+ * @param payload_buffer buffer that receives the payload
+ * @param payload_size size of payload_buffer
+ * @param peak_list peaks found by fft_peaks_find
+ * @param info transform size, sampling rate, source and channel of the result
+ * @return >0 length of the encoded payload
+ * @return -1 NULL pointers passed
+ * @return -2 payload buffer too small
+ * @return -3 failed to prepare metadata section
+ */
+int fft_encode_peaks_frame(uint8_t *payload_buffer, size_t payload_size, const fftPeakListType *peak_list, const fftResultInfoType *info)
+{
+    if (payload_buffer == NULL || peak_list == NULL || info == NULL)
     {
-        error_code = -3;
-        goto memcleanup;
+        return -1;
     }
+    size_t payload_len = FFT_FRAME_METADATA_SIZE + sizeof(float) + peak_list->n_peaks * 2 * sizeof(float);
+    if (peak_list->n_peaks > FFT_PEAK_MAX_PEAKS || payload_size < payload_len)
+    {
+        return -2;
+    }
+    if (fft_prepare_result_metadata(payload_buffer, payload_size, info, peak_list->n_peaks) != 0)
+    {
+        return -3;
+    }
+    size_t pos = FFT_FRAME_METADATA_SIZE;
+    memcpy(&payload_buffer[pos], &peak_list->noise_floor, sizeof(float));
+    pos += sizeof(float);
+    for (uint32_t i = 0; i < peak_list->n_peaks; i++)
+    {
+        memcpy(&payload_buffer[pos], &peak_list->peaks[i].freq_hz, sizeof(float));
+        memcpy(&payload_buffer[pos + sizeof(float)], &peak_list->peaks[i].amplitude, sizeof(float));
+        pos += 2 * sizeof(float);
+    }
+    return (int)pos;
+}
 
-    // metadata_buffer = {n_samples, n_ms_elements}
-    if ((error_code = fft_prepare_metadata_buffer(metadata_buffer, metadata_size, n_samples, n_ms_elements)) != 0)
+/**
+ * @brief Encode the payload of an FFT_COMPONENTS frame
+ *
+ * Payload layout (little endian, no separator flags, framing is done by uart_frame):
+ * u32 n_samples | u32 n_components | u32 sample_rate_hz | u8 source | u8 channel | u16 reserved
+ * u32 indices[n_components]
+ * f32 re, im pairs[n_components]
+ *
+ * @param payload_buffer buffer that receives the payload
+ * @param payload_size size of payload_buffer
+ * @param fft_complex_arr fft complex components array (re, im elements)
+ * @param indexed_magnitudes indexed magnitudes array
+ * @param info transform size, sampling rate, source and channel of the result
+ * @param n_ms_elements number of most significant elements
+ * @return >0 length of the encoded payload
+ * @return -1 NULL pointers passed
+ * @return -2 payload buffer too small
+ * @return -3 failed to prepare metadata section
+ * @return -4 failed to prepare indices section
+ * @return -5 failed to prepare complex data section
+ */
+int fft_encode_frame(uint8_t *payload_buffer, size_t payload_size, float *fft_complex_arr, indexed_float_type *indexed_magnitudes, const fftResultInfoType *info, uint32_t n_ms_elements)
+{
+    size_t indices_size = n_ms_elements * sizeof(uint32_t);
+    size_t complex_size = 2 * n_ms_elements * sizeof(float);
+    size_t pos = 0;
+
+    if (payload_buffer == NULL || fft_complex_arr == NULL || indexed_magnitudes == NULL || info == NULL)
     {
-        // We save sub_error into error_code and ESP_LOGE both
-        ESP_LOGE(TAG, "error -4, sub error %d", error_code);
-        // then we overwrite the error_code with the -n
-        error_code = -4;
-        goto memcleanup;
+        return -1;
+    }
+    if (payload_size < FFT_FRAME_SIZE(n_ms_elements) - UART_FRAME_OVERHEAD)
+    {
+        return -2;
     }
 
-    // indices_buffer holds the indices of the sorted indexed_magnitudes
-    if ((error_code = fft_prepare_indices_buffer(indices_buffer, indices_size, indexed_magnitudes, n_ms_elements)) != 0)
+    // --- Metadata
+    if (fft_prepare_result_metadata(payload_buffer, payload_size, info, n_ms_elements) != 0)
     {
-        ESP_LOGE(TAG, "error -5, sub error %d", error_code);
-        error_code = -5;
-        goto memcleanup;
+        return -3;
     }
+    pos += FFT_FRAME_METADATA_SIZE;
 
-    // Complex buffer holds the pairs of re and im numbers that are located @ indices of the sorted magnitude array
-    if ((error_code = fft_prepare_complex_buffer(complex_buffer, complex_size, n_ms_elements, indexed_magnitudes, fft_complex_arr)) != 0)
+    // --- Indices
+    if (fft_prepare_indices_buffer(&payload_buffer[pos], indices_size, indexed_magnitudes, n_ms_elements) != 0)
     {
-        ESP_LOGE(TAG, "error -6, sub error %d", error_code);
-        error_code = -6;
-        goto memcleanup;
+        return -4;
     }
+    pos += indices_size;
 
-    // Transmit the buffers with specific encapsulation bytes
-    if ((error_code = fft_uart_transmit_data(UART_NUM, metadata_buffer, metadata_size, indices_buffer, indices_size, complex_buffer, complex_size)) != 0)
+    // --- Complex data
+    if (fft_prepare_complex_buffer(&payload_buffer[pos], complex_size, n_ms_elements, indexed_magnitudes, fft_complex_arr) != 0)
     {
-        ESP_LOGE(TAG, "error -7, sub error %d", error_code);
-        error_code = -7;
-        goto memcleanup;
+        return -5;
     }
+    pos += complex_size;
 
-memcleanup:
-    if (metadata_buffer != NULL)
-        free(metadata_buffer);
-    if (indices_buffer != NULL)
-        free(indices_buffer);
-    if (complex_buffer != NULL)
-        free(complex_buffer);
-    return error_code;
+    return (int)pos;
 }
 
 /**
- * @brief UART write metadata, indices and complex data buffers with distinct separator flags
+ * @brief Encode the payload of an FFT_PACKED frame
  *
- * @param metadata_buffer metadata holding the number of readings and the number of most significant components information
- * @param metadata_size size of metadata buffer
- * @param indices_buffer indices of ms components
- * @param indices_size size of indices buffer
- * @param complex_data_buffer real and complex parts of ms components
- * @param complex_size size of complex data buffer
- * @return 0 OK
+ * The components are sorted by bin index so the indices can be delta coded, the host gets the
+ * same indices and (quantised) re, im values as with FFT_ENCODING_RAW, only in index order.
+ * Payload layout: metadata (as fft_encode_frame) | data_codec_encode_spectrum block
+ *
+ * @param payload_buffer buffer that receives the payload
+ * @param payload_size size of payload_buffer
+ * @param fft_complex_arr fft complex components array (re, im elements)
+ * @param indexed_magnitudes indexed magnitudes array (not modified)
+ * @param info transform size, sampling rate, source and channel of the result
+ * @param n_ms_elements number of most significant elements (<= FFT_MS_MAX_COMPONENTS)
+ * @return >0 length of the encoded payload
  * @return -1 NULL pointers passed
- * @return -2 failed to write metadata buffer
- * @return -3 failed to write indices buffer
- * @return -4 failed to write complex data buffer
+ * @return -2 too many components
+ * @return -3 failed to prepare metadata section
+ * @return -4 magnitude index out of range
+ * @return -5 failed to pack the spectrum
  */
-int fft_uart_transmit_data(uart_port_t uart_num, uint8_t *metadata_buffer, size_t metadata_size, uint8_t *indices_buffer, size_t indices_size, uint8_t *complex_data_buffer, size_t complex_size)
+int fft_encode_packed_frame(uint8_t *payload_buffer, size_t payload_size, float *fft_complex_arr, indexed_float_type *indexed_magnitudes, const fftResultInfoType *info, uint32_t n_ms_elements)
 {
-    // const char *TAG = "fft_uart_transmit_data";
-
-    if (metadata_buffer == NULL || indices_buffer == NULL || complex_data_buffer == NULL)
+    if (payload_buffer == NULL || fft_complex_arr == NULL || indexed_magnitudes == NULL || info == NULL)
     {
         return -1;
     }
-
-    // --- Send metadata (xfa)
-    uart_write_bytes(uart_num, "\xfa\xfa\xfa\xfa\xff", 5); // Start of transmission
-    if (uart_write_bytes(uart_num, (const char *)metadata_buffer, metadata_size) == -1)
+    if (n_ms_elements > FFT_MS_MAX_COMPONENTS)
     {
         return -2;
     }
-    uart_write_bytes(uart_num, "\xff\xfa\xfa\xfa\xfa", 5); // End of transmission
-
-    // --- Send indices (xfb)
-    uart_write_bytes(uart_num, "\xfb\xfb\xfb\xfb\xff", 5); // Start of transmission
-    if (uart_write_bytes(uart_num, (const char *)indices_buffer, indices_size) == -1)
+    if (fft_prepare_result_metadata(payload_buffer, payload_size, info, n_ms_elements) != 0)
     {
         return -3;
     }
-    uart_write_bytes(uart_num, "\xff\xfb\xfb\xfb\xfb", 5); // End of transmission
 
-    // --- Send complex data (xfc)
-    uart_write_bytes(uart_num, "\xfc\xfc\xfc\xfc\xff", 5); // Start of transmission
-    if (uart_write_bytes(uart_num, (const char *)complex_data_buffer, complex_size) == -1)
+    // Sort a copy, indexed_magnitudes keeps the ranking order for a resend in the raw encoding
+    memcpy(fft_packed_components, indexed_magnitudes, n_ms_elements * sizeof(indexed_float_type));
+    qsort(fft_packed_components, n_ms_elements, sizeof(indexed_float_type), compare_indexed_float_type_index_ascending);
+    for (uint32_t i = 0; i < n_ms_elements; i++)
     {
-        return -4;
+        uint32_t mag_index = fft_packed_components[i].index * 2;
+        if (mag_index >= FFT_COMPONENTS_SIZE)
+        {
+            return -4;
+        }
+        fft_packed_indices[i] = fft_packed_components[i].index;
+        fft_packed_re_im[2 * i] = fft_complex_arr[mag_index];
+        fft_packed_re_im[2 * i + 1] = fft_complex_arr[mag_index + 1];
     }
-    uart_write_bytes(uart_num, "\xff\xfc\xfc\xfc\xfc", 5); // End of transmission
 
-    return 0;
+    int spectrum_len = data_codec_encode_spectrum(&payload_buffer[FFT_FRAME_METADATA_SIZE], payload_size - FFT_FRAME_METADATA_SIZE,
+                                                  fft_packed_indices, fft_packed_re_im, n_ms_elements);
+    if (spectrum_len < 0)
+    {
+        return -5;
+    }
+    return FFT_FRAME_METADATA_SIZE + spectrum_len;
 }
 
-
 //////////////////////////////////////////////////////////////////
 // -------------------- DEBUGGING FUNCTIONS --------------------//
 //////////////////////////////////////////////////////////////////
@@ -5,25 +5,51 @@
 #include "constants.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_heap_caps.h"
 #include "esp_dsp.h"
 #include <math.h>
 #include "data_structs.h"
 #include "uart_isr_handler.h"
+#include "uart_frame.h"
+#include "data_codec.h"
+#include "fft_ansi.h"
+#include "fft_select.h"
+#include "fft_peaks.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
 
 int fft_init();
-void fft_prepare_window(float *window_arr);
+int fft_set_mode(fft_mode_type mode);
+fft_mode_type fft_get_mode(void);
+int fft_set_encoding(fft_encoding_type encoding);
+fft_encoding_type fft_get_encoding(void);
+int fft_set_window(fft_window_type window);
+fft_window_type fft_get_window(void);
+const char *fft_get_backend_name(uint32_t n_samples);
+int fft_set_dual_core(bool enabled);
+bool fft_get_dual_core(void);
 void fft_prepare_complex_arr(float *sampled_data_arr, float *complex_arr, uint32_t arr_len);
+void fft_prepare_complex_arr_raw(const int16_t *raw_arr, float bias, float scale, float *complex_arr, uint32_t arr_len);
 void fft_calculate_re_im(float *fft_components, uint32_t n_samples);
+void fft_real_split(float *complex_arr, uint32_t n_samples);
 void fft_calculate_magnitudes(indexed_float_type *indexed_magnitudes_arr, float *fft_complex_arr, uint32_t magnitudes_size);
 void fft_sort_magnitudes(indexed_float_type *indexed_mangitudes, uint32_t magnitudes_size);
+int fft_sc16_prepare(const int16_t *raw_arr, float bias, int16_t *sc16_arr, uint32_t n_samples);
+void fft_sc16_calculate_re_im(int16_t *sc16_arr, uint32_t n_samples);
+void fft_sc16_to_fc32(int16_t *sc16_arr, indexed_uint_type *indexed_powers, uint32_t n_samples, uint32_t n_top, int shift, float scale);
 void fft_plot_magnitudes(indexed_float_type *indexed_magnitudes, uint32_t length, int min, int max);
 int compare_indexed_float_type_descending(const void *, const void *);
-uint32_t fft_percentile_n_components(float percentile, uint32_t arr_len);
+int compare_indexed_float_type_index_ascending(const void *, const void *);
 int fft_prepare_metadata_buffer(uint8_t *metadata_buffer, size_t metadata_size, uint32_t n_samples, uint32_t n_components);
 int fft_prepare_indices_buffer(uint8_t *indices_buffer, size_t indices_size, indexed_float_type *indexed_magnitudes, uint32_t n_ms_components);
 int fft_prepare_complex_buffer(uint8_t *complex_data_buffer, size_t complex_size, uint32_t n_fft_components, indexed_float_type *indexed_mangitudes, float *fft_components);
-int fft_send_ms_components_over_uart(float *fft_complex_arr, indexed_float_type *indexed_magnitudes, uint32_t n_samples, uint32_t n_ms_elements);
-int fft_uart_transmit_data(uart_port_t uart_num, uint8_t *metadata_buffer, size_t metadata_size, uint8_t *indices_buffer, size_t indices_size, uint8_t *complex_data_buffer, size_t complex_size);
+int fft_send_ms_components_over_uart(float *fft_complex_arr, indexed_float_type *indexed_magnitudes, const fftResultInfoType *info, uint32_t n_ms_elements);
+int fft_encode_frame(uint8_t *payload_buffer, size_t payload_size, float *fft_complex_arr, indexed_float_type *indexed_magnitudes, const fftResultInfoType *info, uint32_t n_ms_elements);
+int fft_encode_packed_frame(uint8_t *payload_buffer, size_t payload_size, float *fft_complex_arr, indexed_float_type *indexed_magnitudes, const fftResultInfoType *info, uint32_t n_ms_elements);
+int fft_send_peaks_over_uart(const fftPeakListType *peak_list, const fftResultInfoType *info);
+int fft_encode_peaks_frame(uint8_t *payload_buffer, size_t payload_size, const fftPeakListType *peak_list, const fftResultInfoType *info);
 
 // Debugging functions
 int fft_prepare_indices_magnitudes_buffer_debugging(uint8_t *indices_buffer, size_t indices_size, uint8_t *magnitudes_buffer, size_t magnitudes_size, indexed_float_type *indexed_magnitudes, uint32_t n_ms_components);
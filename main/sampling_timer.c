@@ -0,0 +1,193 @@
+#include "sampling_timer.h"
+
+static gptimer_handle_t sampling_timer_handle = NULL;
+static SemaphoreHandle_t semphr_sampling_tick = NULL;
+static uint32_t sampling_timer_rate_hz = 0;
+static volatile uint32_t sampling_timer_overruns = 0; // Ticks that fired before the previous one was consumed
+static bool sampling_timer_running = false;
+
+/**
+ * @brief Sampling timer alarm ISR callback
+ *
+ * Releases the sampling task once per period. If the previous tick was not consumed yet,
+ * the sampling task is running late and the tick is counted as an overrun.
+ *
+ * @return true if a higher priority task was woken
+ */
+static bool IRAM_ATTR sampling_timer_on_alarm(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata, void *user_ctx)
+{
+    BaseType_t high_task_awoken = pdFALSE;
+    if (xSemaphoreGiveFromISR(semphr_sampling_tick, &high_task_awoken) != pdTRUE)
+    {
+        sampling_timer_overruns++;
+    }
+    return high_task_awoken == pdTRUE;
+}
+
+/**
+ * @brief Create the sampling timer and its tick semaphore
+ *
+ * The timer is created stopped. Call sampling_timer_start to start the periodic ticks.
+ *
+ * @param rate_hz sampling rate in Hz
+ * @return 0 OK
+ * @return -1 failed to create tick semaphore
+ * @return -2 failed to create gptimer
+ * @return -3 failed to register alarm callback
+ * @return -4 invalid sampling rate or failed to set alarm action
+ * @return -5 failed to enable gptimer
+ */
+int sampling_timer_init(uint32_t rate_hz)
+{
+    const char *TAG = "SAMPL TIMER INIT";
+
+    semphr_sampling_tick = xSemaphoreCreateBinary();
+    if (semphr_sampling_tick == NULL)
+    {
+        return -1;
+    }
+
+    gptimer_config_t timer_config = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = SAMPLING_TIMER_RESOLUTION_HZ,
+    };
+    if (gptimer_new_timer(&timer_config, &sampling_timer_handle) != ESP_OK)
+    {
+        return -2;
+    }
+
+    gptimer_event_callbacks_t callbacks = {
+        .on_alarm = sampling_timer_on_alarm,
+    };
+    if (gptimer_register_event_callbacks(sampling_timer_handle, &callbacks, NULL) != ESP_OK)
+    {
+        return -3;
+    }
+    if (sampling_timer_set_rate(rate_hz) != 0)
+    {
+        ESP_LOGE(TAG, "Invalid sampling rate %lu Hz", rate_hz);
+        return -4;
+    }
+    if (gptimer_enable(sampling_timer_handle) != ESP_OK)
+    {
+        return -5;
+    }
+    return 0;
+}
+
+/**
+ * @brief Set the sampling timer period
+ *
+ * The rate must divide the timer resolution so the period is exact and has no drift.
+ * The rate can only be changed while the timer is stopped.
+ *
+ * @param rate_hz sampling rate in Hz (1000, 2000, 4000 or 8000)
+ * @return 0 OK
+ * @return -1 rate out of range or not an exact divider of the timer resolution
+ * @return -2 timer is running
+ * @return -3 failed to set alarm action
+ */
+int sampling_timer_set_rate(uint32_t rate_hz)
+{
+    if (rate_hz == 0 || rate_hz > MPU_GYRO_OUTPUT_RATE_HZ || (SAMPLING_TIMER_RESOLUTION_HZ % rate_hz) != 0)
+    {
+        return -1;
+    }
+    if (sampling_timer_running)
+    {
+        return -2;
+    }
+
+    gptimer_alarm_config_t alarm_config = {
+        .alarm_count = SAMPLING_TIMER_RESOLUTION_HZ / rate_hz,
+        .reload_count = 0,
+        .flags.auto_reload_on_alarm = true,
+    };
+    if (gptimer_set_alarm_action(sampling_timer_handle, &alarm_config) != ESP_OK)
+    {
+        return -3;
+    }
+    sampling_timer_rate_hz = rate_hz;
+    return 0;
+}
+
+uint32_t sampling_timer_get_rate(void)
+{
+    return sampling_timer_rate_hz;
+}
+
+/**
+ * @brief Start periodic sampling ticks
+ *
+ * Overrun counter and any stale tick are cleared, the first tick comes one full period after the start.
+ *
+ * @return 0 OK
+ * @return -1 timer not initialised
+ * @return -2 failed to start the timer
+ */
+int sampling_timer_start(void)
+{
+    if (sampling_timer_handle == NULL)
+    {
+        return -1;
+    }
+    if (sampling_timer_running)
+    {
+        return 0;
+    }
+    xSemaphoreTake(semphr_sampling_tick, 0);
+    sampling_timer_overruns = 0;
+    gptimer_set_raw_count(sampling_timer_handle, 0);
+    if (gptimer_start(sampling_timer_handle) != ESP_OK)
+    {
+        return -2;
+    }
+    sampling_timer_running = true;
+    return 0;
+}
+
+/**
+ * @brief Stop periodic sampling ticks
+ *
+ * @return 0 OK
+ * @return -1 timer not initialised
+ * @return -2 failed to stop the timer
+ */
+int sampling_timer_stop(void)
+{
+    if (sampling_timer_handle == NULL)
+    {
+        return -1;
+    }
+    if (!sampling_timer_running)
+    {
+        return 0;
+    }
+    if (gptimer_stop(sampling_timer_handle) != ESP_OK)
+    {
+        return -2;
+    }
+    sampling_timer_running = false;
+    return 0;
+}
+
+/**
+ * @brief Block until the next sampling tick
+ *
+ * @param timeout max number of RTOS ticks to wait
+ * @return true tick received
+ * @return false timeout
+ */
+bool sampling_timer_wait_tick(TickType_t timeout)
+{
+    return xSemaphoreTake(semphr_sampling_tick, timeout) == pdTRUE;
+}
+
+/**
+ * @brief Number of ticks missed since the last sampling_timer_start
+ */
+uint32_t sampling_timer_get_overruns(void)
+{
+    return sampling_timer_overruns;
+}
@@ -0,0 +1,21 @@
+#ifndef SAMPLING_TIMER_H
+#define SAMPLING_TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "driver/gptimer.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "constants.h"
+
+int sampling_timer_init(uint32_t rate_hz);
+int sampling_timer_set_rate(uint32_t rate_hz);
+uint32_t sampling_timer_get_rate(void);
+int sampling_timer_start(void);
+int sampling_timer_stop(void);
+bool sampling_timer_wait_tick(TickType_t timeout);
+uint32_t sampling_timer_get_overruns(void);
+
+#endif // SAMPLING_TIMER_H
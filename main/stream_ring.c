@@ -0,0 +1,106 @@
+#include "stream_ring.h"
+
+/**
+ * @brief Allocate the ring buffer of the streaming mode
+ *
+ * @param ring stream ring to initialize
+ * @param size ring length in samples (> STREAM_WINDOW_SIZE)
+ * @return 0 OK
+ * @return -1 NULL pointer passed or ring shorter than a window
+ * @return -2 failed to allocate the ring
+ */
+int stream_ring_init(streamRingType *ring, uint32_t size)
+{
+    if (ring == NULL || size <= STREAM_WINDOW_SIZE)
+    {
+        return -1;
+    }
+    memset(ring, 0, sizeof(streamRingType));
+
+    ring->samples = (int16_t *)heap_caps_malloc(size * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+    if (ring->samples == NULL)
+    {
+        return -2;
+    }
+    ring->size = size;
+    return stream_ring_reset(ring, 0, NULL);
+}
+
+/**
+ * @brief Restart the stream on a channel and latch its bias and scale
+ *
+ * Must not be called while the stream is running.
+ *
+ * @param ring stream ring
+ * @param channel recorded channel (0..5)
+ * @param mpu_data_t struct with avg_err used as bias (NULL for zero bias)
+ * @return 0 OK
+ * @return -1 NULL pointer passed or invalid channel
+ */
+int stream_ring_reset(streamRingType *ring, uint8_t channel, const mpuDataType *mpu_data_t)
+{
+    if (ring == NULL || channel >= CAPTURE_N_CHANNELS)
+    {
+        return -1;
+    }
+    ring->channel = channel;
+    ring->bias = (mpu_data_t != NULL) ? mpu_data_t->avg_err[channel] : 0.0f;
+    ring->scale = (channel < 3) ? (1.0f / MPU_ACCEL_FS) : (1.0f / MPU_GYRO_FS);
+    ring->write_position = 0;
+    ring->next_window_start = 0;
+    ring->windows_dropped = 0;
+    ring->windows_overwritten = 0;
+    return 0;
+}
+
+/**
+ * @brief Append one sample and report a completed window
+ *
+ * @param ring stream ring
+ * @param sample raw count of the stream channel
+ * @param window_start absolute position of the completed window
+ * @return true if the sample completed a window (the next one starts STREAM_HOP_SIZE later)
+ */
+bool stream_ring_push(streamRingType *ring, int16_t sample, uint32_t *window_start)
+{
+    ring->samples[ring->write_position % ring->size] = sample;
+    ring->write_position++;
+
+    if (ring->write_position - ring->next_window_start < STREAM_WINDOW_SIZE)
+    {
+        return false;
+    }
+    *window_start = ring->next_window_start;
+    ring->next_window_start += STREAM_HOP_SIZE;
+    return true;
+}
+
+/**
+ * @brief Copy a window out of the ring into a contiguous array
+ *
+ * The sampling task keeps writing during the copy, so the window is checked after the copy:
+ * if the writer has reached the start of the window in the meantime, the copy is corrupted.
+ *
+ * @param ring stream ring
+ * @param window_start absolute position of the window
+ * @param window_arr array that receives window_size samples
+ * @param window_size number of samples to copy
+ * @return 0 OK
+ * @return -1 window was (partly) overwritten before or during the copy
+ */
+int stream_ring_copy_window(const streamRingType *ring, uint32_t window_start, int16_t *window_arr, uint32_t window_size)
+{
+    uint32_t slot = window_start % ring->size;
+    uint32_t first_len = ring->size - slot;
+    if (first_len > window_size)
+        first_len = window_size;
+
+    memcpy(window_arr, &ring->samples[slot], first_len * sizeof(int16_t));
+    memcpy(&window_arr[first_len], ring->samples, (window_size - first_len) * sizeof(int16_t));
+
+    if (ring->write_position - window_start > ring->size)
+    {
+        return -1;
+    }
+    return 0;
+}
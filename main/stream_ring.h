@@ -0,0 +1,16 @@
+#ifndef STREAM_RING_H
+#define STREAM_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "constants.h"
+#include "data_structs.h"
+
+int stream_ring_init(streamRingType *ring, uint32_t size);
+int stream_ring_reset(streamRingType *ring, uint8_t channel, const mpuDataType *mpu_data_t);
+bool stream_ring_push(streamRingType *ring, int16_t sample, uint32_t *window_start);
+int stream_ring_copy_window(const streamRingType *ring, uint32_t window_start, int16_t *window_arr, uint32_t window_size);
+
+#endif // STREAM_RING_H
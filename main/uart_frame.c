@@ -0,0 +1,154 @@
+#include "uart_frame.h"
+
+static uart_port_t frame_uart_num = UART_NUM_0;
+static SemaphoreHandle_t frame_mutex = NULL;
+static uint16_t frame_sequence = 0;
+
+/**
+ * @brief Create the mutex that serializes frame sequence numbers and UART writes
+ *
+ * @param uart_num UART port used by uart_frame_send*
+ * @return 0 OK
+ * @return -1 failed to create the mutex
+ */
+int uart_frame_init(uart_port_t uart_num)
+{
+    frame_uart_num = uart_num;
+    frame_sequence = 0;
+    if (frame_mutex == NULL)
+    {
+        frame_mutex = xSemaphoreCreateMutex();
+        if (frame_mutex == NULL)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Write the header and CRC around a payload that is already in the frame buffer
+ *
+ * The payload must be placed at frame_buffer + UART_FRAME_HEADER_SIZE by the caller, so large
+ * payloads are encoded in place without copying.
+ *
+ * @param frame_buffer frame buffer with the payload at offset UART_FRAME_HEADER_SIZE
+ * @param frame_size size of the frame buffer
+ * @param type uart_frame_type of the payload
+ * @param sequence frame sequence number
+ * @param payload_len payload length in bytes
+ * @return >0 total frame length
+ * @return -1 NULL pointer passed
+ * @return -2 frame buffer too small for the payload
+ */
+int uart_frame_encode(uint8_t *frame_buffer, size_t frame_size, uint8_t type, uint16_t sequence, size_t payload_len)
+{
+    if (frame_buffer == NULL)
+    {
+        return -1;
+    }
+    if (frame_size < UART_FRAME_OVERHEAD || payload_len > frame_size - UART_FRAME_OVERHEAD)
+    {
+        return -2;
+    }
+
+    frame_buffer[0] = UART_FRAME_MAGIC_0;
+    frame_buffer[1] = UART_FRAME_MAGIC_1;
+    frame_buffer[2] = UART_FRAME_VERSION;
+    frame_buffer[3] = type;
+    frame_buffer[4] = (uint8_t)(sequence & 0xFF);
+    frame_buffer[5] = (uint8_t)(sequence >> 8);
+    for (int i = 0; i < 4; i++)
+    {
+        frame_buffer[6 + i] = (uint8_t)(payload_len >> (8 * i));
+    }
+
+    // CRC covers everything after the magic bytes, so a resync on a false magic is rejected
+    uint32_t crc = esp_rom_crc32_le(0, &frame_buffer[2], UART_FRAME_HEADER_SIZE - 2 + payload_len);
+    uint8_t *crc_ptr = &frame_buffer[UART_FRAME_HEADER_SIZE + payload_len];
+    for (int i = 0; i < 4; i++)
+    {
+        crc_ptr[i] = (uint8_t)(crc >> (8 * i));
+    }
+    return (int)(UART_FRAME_OVERHEAD + payload_len);
+}
+
+/**
+ * @brief Encode a frame in place and send it with one UART write
+ *
+ * The sequence number is assigned under the frame mutex, so frames of different tasks leave the
+ * UART in sequence order and never interleave.
+ *
+ * @param frame_buffer frame buffer with the payload at offset UART_FRAME_HEADER_SIZE
+ * @param frame_size size of the frame buffer
+ * @param type uart_frame_type of the payload
+ * @param payload_len payload length in bytes
+ * @return 0 OK
+ * @return -1 uart_frame_init was not called
+ * @return -2 failed to encode the frame
+ * @return -3 failed to write the frame
+ */
+int uart_frame_send_buffer(uint8_t *frame_buffer, size_t frame_size, uint8_t type, size_t payload_len)
+{
+    if (frame_mutex == NULL)
+    {
+        return -1;
+    }
+    xSemaphoreTake(frame_mutex, portMAX_DELAY);
+
+    int error_code = 0;
+    int frame_len = uart_frame_encode(frame_buffer, frame_size, type, frame_sequence, payload_len);
+    if (frame_len < 0)
+    {
+        error_code = -2;
+    }
+    else if (uart_write_bytes(frame_uart_num, frame_buffer, frame_len) != frame_len)
+    {
+        error_code = -3;
+    }
+    else
+    {
+        frame_sequence++;
+    }
+
+    xSemaphoreGive(frame_mutex);
+    return error_code;
+}
+
+/**
+ * @brief Copy a short payload into a frame on the stack and send it
+ *
+ * @param type uart_frame_type of the payload
+ * @param payload payload bytes
+ * @param payload_len payload length (<= UART_FRAME_STATUS_MAX_LEN)
+ * @return 0 OK
+ * @return -1 uart_frame_init was not called
+ * @return -2 NULL pointer passed or payload too long
+ * @return -3 failed to write the frame
+ */
+int uart_frame_send(uint8_t type, const uint8_t *payload, size_t payload_len)
+{
+    uint8_t frame_buffer[UART_FRAME_OVERHEAD + UART_FRAME_STATUS_MAX_LEN];
+    if ((payload == NULL && payload_len > 0) || payload_len > UART_FRAME_STATUS_MAX_LEN)
+    {
+        return -2;
+    }
+    if (payload_len > 0)
+    {
+        memcpy(&frame_buffer[UART_FRAME_HEADER_SIZE], payload, payload_len);
+    }
+    return uart_frame_send_buffer(frame_buffer, sizeof(frame_buffer), type, payload_len);
+}
+
+/**
+ * @brief Send an ASCII status message ("A DATRDY", "FAIL", ...) as a STATUS frame
+ *
+ * @param status NULL terminated status text, truncated to UART_FRAME_STATUS_MAX_LEN
+ * @return 0 OK
+ * @return <0 error of uart_frame_send
+ */
+int uart_frame_send_status(const char *status)
+{
+    size_t len = strnlen(status, UART_FRAME_STATUS_MAX_LEN);
+    return uart_frame_send(UART_FRAME_TYPE_STATUS, (const uint8_t *)status, len);
+}
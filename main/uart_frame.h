@@ -0,0 +1,30 @@
+#ifndef UART_FRAME_H
+#define UART_FRAME_H
+
+#include <stdint.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "driver/uart.h"
+#include "esp_rom_crc.h"
+#include "constants.h"
+
+// Payload types of the UART frames
+typedef enum uart_frame_type
+{
+    UART_FRAME_TYPE_STATUS = 0x01,           // ASCII status text ("A DATRDY", "FAIL", ...)
+    UART_FRAME_TYPE_FFT_COMPONENTS = 0x02,   // FFT metadata, indices and re, im pairs
+    UART_FRAME_TYPE_FFT_PACKED = 0x03,       // FFT metadata and data_codec packed spectrum
+    UART_FRAME_TYPE_RAW_SAMPLES = 0x04,      // Chunk of raw capture counts with bias and scale
+    UART_FRAME_TYPE_RAW_SAMPLES_RICE = 0x05, // RAW_SAMPLES chunk with Rice coded counts (data_codec)
+    UART_FRAME_TYPE_GOERTZEL = 0x06,         // Amplitudes of the Goertzel bank frequencies of one block
+    UART_FRAME_TYPE_FFT_PEAKS = 0x07,        // FFT metadata, noise floor and interpolated peaks
+} uart_frame_type;
+
+int uart_frame_init(uart_port_t uart_num);
+int uart_frame_encode(uint8_t *frame_buffer, size_t frame_size, uint8_t type, uint16_t sequence, size_t payload_len);
+int uart_frame_send_buffer(uint8_t *frame_buffer, size_t frame_size, uint8_t type, size_t payload_len);
+int uart_frame_send(uint8_t type, const uint8_t *payload, size_t payload_len);
+int uart_frame_send_status(const char *status);
+
+#endif // UART_FRAME_H
@@ -52,254 +52,88 @@ int myuart_init_with_isr_queue(uart_config_t *uart_config, uart_port_t port_num,
 }
 
 /**
- * @brief Encapsulated message start flag handling
+ * @brief Copy a received message into a queue item and send it to the message handler task
  *
- * Confirm the structure of encapsulated messages start flag.
+ * The message is carried inline in the queue item and terminated with '\0', no heap is used.
  *
- * @param uart_num uart port number
- * @param encap_start_buf uint8_t encapsulation start flag buffer
- * @param pattern_index starting index of the detected pattern
- * @return 0 OK
- * @return -1 failed malloc
- * @return -2 not enough bytes in RX buffer
- */
-int myuart_encapsulation_start_flag_handler(uart_port_t uart_num, int pattern_index)
-{
-	const char *TAG = "ENCAP START";
-
-	int message_size = pattern_index + ENCAP_FLAG_SIZE;
-	uint8_t *tmp_buffer = (uint8_t *)malloc(message_size * sizeof(uint8_t));
-	if (tmp_buffer == NULL)
-	{
-		ESP_LOGE(TAG, "Failed to malloc tmp_buffer");
-		return -2;
-	}
-
-	if (uart_read_bytes(uart_num, tmp_buffer, message_size, pdMS_TO_TICKS(100)) != message_size)
-	{
-		ESP_LOGE(TAG, "Wrong message size");
-		free(tmp_buffer);
-		return -3;
-	}
-
-	int return_value = memcmp(&tmp_buffer[pattern_index], ENCAP_START_PAT, ENCAP_FLAG_SIZE);
-	free(tmp_buffer);
-	tmp_buffer = NULL;
-
-	return return_value;
-}
-
-/**
- * @brief Encapsulated message end flag handling
- *
- * Confirm the position and structure of the encapsulated messages end flag
- *
- * @param uart_num uart port number
- * @param encap_stop_buf uint8_t encapsulation end flag buffer
- * @param pattern_index starting index of the detected pattern
+ * @param message received message bytes
+ * @param message_size number of bytes
  * @return 0 OK
- * @return -1 wrong pattern indice
- * @return -2 not enough bytes in RX buffer
+ * @return -1 null pointer passed
+ * @return -2 message longer than UART_MSG_MAX_LEN
+ * @return -3 failed to send the message to queue
  */
-int myuart_encapsulation_end_flag_handler(uart_port_t uart_num, int pattern_index)
-{
-	uint8_t *tmp_buffer = (uint8_t *)malloc(ENCAP_FLAG_SIZE * sizeof(uint8_t));
-
-	const char *TAG = "ENCAP STOP";
-
-	if (pattern_index != 1)
-	{
-		ESP_LOGE(TAG, "Pat indice != -1");
-		return -2;
-	}
-
-	if (uart_read_bytes(uart_num, tmp_buffer, ENCAP_FLAG_SIZE, pdMS_TO_TICKS(100)) != ENCAP_FLAG_SIZE)
-	{
-		ESP_LOGE(TAG, "Incorrect message size");
-		return -3;
-	}
-
-	int return_value = memcmp(tmp_buffer, ENCAP_END_PAT, ENCAP_FLAG_SIZE);
-	free(tmp_buffer);
-	tmp_buffer = NULL;
-	return return_value;
-}
-
-/**
- * @brief Store the encapsulated message
- *
- * @param uart_num uart port number
- * @param message_buf uint8_t message buffer array
- * @param message_size message buffer size
- * @return 0 OK
- * @return -1 null operator passed
- * @return -2 message_size < 0
- * @return -3 not enough bytes in RX buffer
- */
-int myuart_encapsulated_message_handler(uart_port_t uart_num, uint8_t *message_buf, int message_size)
-{
-	/*
-	This function simply reads the encapsulated message that should sit between two encapsulation flags.
-	*/
-	const char *TAG = "ENCAP MSG";
-	if (message_buf == NULL)
-	{
-		ESP_LOGE(TAG, "Null operators passed to the function");
-		return -1;
-	}
-	if (message_size < 0)
-		return -2;
-
-	if (uart_read_bytes(uart_num, message_buf, message_size, pdMS_TO_TICKS(100)) != message_size)
-	{
-		ESP_LOGE(TAG, "Wrong message size");
-		return -3;
-	}
-	return 0;
-}
-
-int myuart_message_send_to_queue(uint8_t *message, size_t message_size)
+int myuart_message_send_to_queue(const uint8_t *message, size_t message_size)
 {
 	const char *TAG = "MSG PREP SEND TO Q";
+	TaskQueueMessage_type message_to_queue;
 
 	if (message == NULL)
 	{
 		ESP_LOGE(TAG, "Message null pointer passed");
 		return -1;
 	}
-
-	TaskQueueMessage_type message_to_queue = {
-		.msg_ptr = (uint8_t *)malloc(message_size * sizeof(uint8_t)),
-		.msg_size = message_size};
-
-	if (message_to_queue.msg_ptr == NULL)
+	if (message_size > UART_MSG_MAX_LEN)
 	{
-		ESP_LOGE(TAG, "Failed to malloc queued message buffer");
 		return -2;
 	}
-	// Copy message to the new address
-	memcpy(message_to_queue.msg_ptr, message, message_size * sizeof(uint8_t));
 
-	// Send the message to queue
-	if (xQueueSend(queue_enqueued_msg_processing, &message_to_queue, portMAX_DELAY) != pdTRUE)
+	memcpy(message_to_queue.msg, message, message_size);
+	message_to_queue.msg[message_size] = '\0';
+	message_to_queue.msg_size = message_size;
+
+	// Send the message to queue, the queue copies the whole item
+	if (xQueueSend(queue_enqueued_msg_processing, &message_to_queue, 0) != pdTRUE)
 	{
-		free(message_to_queue.msg_ptr);
 		return -3;
 	}
 	return 0;
 }
 
 /**
- * @brief Handles the state of the received message and manages the UART communication flow
+ * @brief Read the bytes of a UART_DATA event and queue every completed message
  *
- * Function checks if the successfull start and stop flags have been received and if the received message was complete.
+ * The bytes already sit in the driver RX ring buffer, they are read without waiting in UART_RX_CHUNK_SIZE
+ * chunks and fed to the parser, which keeps partial frames between events. The message queue is not
+ * waited on either, a full queue drops the message and is counted.
  *
  * @param uart_num uart port number
- * @param encap_state encapsulation state counter (nothing happened = 0, start flag received = 1, stop flag received = 2)
- * @param pattern_index index of the detected pattern
- * @param encap_start_buf debug buffer for checking how the received start flag looks like
- * @param encap_stop_buf debuf buffer for checking how the stop flag looks like
- * @param message_buf received message buffer
- * @param message_size received message size
- * @return 1 start flag ok message received successfully
- * @return 0 message received ok
- * @return -1 bad start flag
- * @return -2 message size < 1
- * @return -3 failed to malloc message buffer
- * @return -4 failed to to read the message from RX buffer
- * @return -5 failed malloc message buffer for queue message
- * @return -6 failed to send the message copy to queue
- * @return -7 bad stop flag
+ * @param parser receive parser
+ * @param data_len number of received bytes reported by the event
+ * @return 0 OK
+ * @return -1 fewer bytes in the RX buffer than reported
  */
-int myuart_encapsulation_handler(uart_port_t uart_num, int *encap_state, int *pattern_index)
+int myuart_receive_data(uart_port_t uart_num, uartRxParserType *parser, size_t data_len)
 {
-	enum encap_states
-	{
-		START_FLAG_CONFIRMATION,
-		END_FLAG_CONFIRMATION,
-	};
-	const char *TAG = "ENCAP HANDLER";
-	uint8_t *tmp_message_buf = NULL;
-	int tmp_message_size = 0; // To store corrected message size
-	int error_code = 0;		  // To store the error code and then return it
+	uint8_t chunk[UART_RX_CHUNK_SIZE];
+	int64_t event_us = esp_timer_get_time();
 
-	switch (*encap_state)
+	while (data_len > 0)
 	{
-	case START_FLAG_CONFIRMATION:
-		/**
-		 * @brief Read and check the START FLAG
-		 */
-		if (myuart_encapsulation_start_flag_handler(UART_NUM, *pattern_index) == 0)
-		{
-			(*encap_state)++;
-			return 1; // Start flag OK, return immediately
-		}
-		else
-		{
-			ESP_LOGD(TAG, "Bad start flag");
-			error_code = -1; // Error code for bad start flag
-			goto memcleanup;
-		}
-		break;
-
-	case END_FLAG_CONFIRMATION:
-		tmp_message_size = *pattern_index - 1;
-
-		if (tmp_message_size < 1)
-		{
-			ESP_LOGD(TAG, "Message size %d is less than 1", tmp_message_size);
-			error_code = -2; // Error code for invalid message size
-			goto memcleanup;
-		}
+		int chunk_len = uart_read_bytes(uart_num, chunk, (data_len < sizeof(chunk)) ? data_len : sizeof(chunk), 0);
+		if (chunk_len <= 0)
+			return -1;
+		data_len -= chunk_len;
 
-		tmp_message_buf = (uint8_t *)malloc(tmp_message_size * sizeof(uint8_t));
-		if (tmp_message_buf == NULL)
+		size_t offset = 0;
+		while (offset < (size_t)chunk_len)
 		{
-			ESP_LOGE(TAG, "Failed to malloc tmp message buffer");
-			error_code = -3; // Error code for memory allocation failure
-			goto memcleanup;
-		}
+			bool msg_ready = false;
+			offset += uart_rx_parser_feed(parser, &chunk[offset], chunk_len - offset, &msg_ready);
+			if (!msg_ready)
+				continue;
 
-		/**
-		 * @brief Read the MESSAGE bytes
-		 */
-		if (myuart_encapsulated_message_handler(UART_NUM, tmp_message_buf, tmp_message_size) == 0)
-		{
-			*pattern_index -= tmp_message_size;
-		}
-		else
-		{
-			ESP_LOGE(TAG, "Failed to receive message");
-			error_code = -4; // Error code for failed message receipt
-			goto memcleanup;
-		}
-
-		/**
-		 * @brief Read and check STOP FLAG
-		 */
-		if (myuart_encapsulation_end_flag_handler(UART_NUM, *pattern_index) == 0)
-		{
-			if (myuart_message_send_to_queue(tmp_message_buf, tmp_message_size) != 0)
+			if (myuart_message_send_to_queue((const uint8_t *)parser->msg, parser->msg_len) != 0)
 			{
-				ESP_LOGE(TAG, "Failed to send message to queue");
+				parser->stats.errors_queue++;
+				continue;
 			}
+			uint32_t latency_us = (uint32_t)(esp_timer_get_time() - event_us);
+			parser->stats.frames++;
+			parser->stats.latency_us_last = latency_us;
+			if (latency_us > parser->stats.latency_us_max)
+				parser->stats.latency_us_max = latency_us;
 		}
-		else
-		{
-			ESP_LOGD(TAG, "Bad stop flag");
-			error_code = -7; // Error code for failed stop flag
-		}
-		break;
-
-	default:
-		break;
 	}
-memcleanup:
-	if (tmp_message_buf != NULL)
-	{
-		free(tmp_message_buf);
-	}
-	*encap_state = 0;
-	uart_pattern_queue_reset(UART_NUM, UART_PAT_QUEUE_SIZE);
-	return error_code;
-}
\ No newline at end of file
+	return 0;
+}
@@ -0,0 +1,111 @@
+#include "uart_rx_parser.h"
+
+/**
+ * @brief Advance a flag match by one byte
+ *
+ * On a mismatch the match falls back to the longest flag prefix that still ends the received bytes,
+ * so "+++*" is found as a start flag without reading any byte twice.
+ *
+ * @param flag start or end flag (ENCAP_FLAG_SIZE chars)
+ * @param flag_pos bytes of the flag matched so far (< ENCAP_FLAG_SIZE)
+ * @param byte received byte
+ * @return bytes of the flag matched including byte
+ */
+static uint8_t uart_rx_flag_advance(const char *flag, uint8_t flag_pos, uint8_t byte)
+{
+    for (uint8_t k = flag_pos + 1; k > 0; k--)
+    {
+        // flag[0..k-1] must equal the last k-1 matched bytes followed by byte
+        if ((uint8_t)flag[k - 1] == byte && memcmp(flag, &flag[flag_pos + 1 - k], k - 1) == 0)
+            return k;
+    }
+    return 0;
+}
+
+/**
+ * @brief Clear the parser state and its counters
+ *
+ * @param parser receive parser
+ */
+void uart_rx_parser_reset(uartRxParserType *parser)
+{
+    memset(parser, 0, sizeof(uartRxParserType));
+    parser->state = UART_RX_HUNT;
+}
+
+/**
+ * @brief Drop the frame in progress after received bytes were lost and count the receive error
+ *
+ * The parser hunts for the next start flag, the counters except errors_rx are kept.
+ *
+ * @param parser receive parser
+ */
+void uart_rx_parser_reset_error(uartRxParserType *parser)
+{
+    parser->state = UART_RX_HUNT;
+    parser->flag_pos = 0;
+    parser->stats.errors_rx++;
+}
+
+/**
+ * @brief Feed received bytes to the parser until a complete message is found
+ *
+ * Every byte is looked at once. Bytes outside of a frame are dropped and counted, a message longer
+ * than UART_MSG_MAX_LEN is dropped and the parser hunts for the next start flag. The call returns
+ * right after the end flag of a message, the caller handles parser->msg and feeds the remaining bytes.
+ *
+ * @param parser receive parser
+ * @param data received bytes
+ * @param data_len number of received bytes
+ * @param msg_ready set to true if parser->msg holds a complete message (parser->msg_len bytes)
+ * @return number of consumed bytes
+ */
+size_t uart_rx_parser_feed(uartRxParserType *parser, const uint8_t *data, size_t data_len, bool *msg_ready)
+{
+    *msg_ready = false;
+
+    for (size_t i = 0; i < data_len; i++)
+    {
+        uint8_t byte = data[i];
+
+        if (parser->state == UART_RX_HUNT)
+        {
+            uint8_t flag_pos = uart_rx_flag_advance(ENCAP_START_PAT, parser->flag_pos, byte);
+            // Bytes that leave the flag match are not part of a frame
+            parser->stats.bytes_dropped += parser->flag_pos + 1 - flag_pos;
+            parser->flag_pos = flag_pos;
+            if (flag_pos == ENCAP_FLAG_SIZE)
+            {
+                parser->state = UART_RX_MESSAGE;
+                parser->flag_pos = 0;
+                parser->msg_len = 0;
+            }
+            continue;
+        }
+
+        parser->msg[parser->msg_len++] = (char)byte;
+        parser->flag_pos = uart_rx_flag_advance(ENCAP_END_PAT, parser->flag_pos, byte);
+        if (parser->flag_pos == ENCAP_FLAG_SIZE)
+        {
+            parser->state = UART_RX_HUNT;
+            parser->flag_pos = 0;
+            parser->msg_len -= ENCAP_FLAG_SIZE;
+            if (parser->msg_len == 0)
+            {
+                parser->stats.errors_empty++;
+                continue;
+            }
+            parser->msg[parser->msg_len] = '\0';
+            *msg_ready = true;
+            return i + 1;
+        }
+        if (parser->msg_len == UART_MSG_MAX_LEN + ENCAP_FLAG_SIZE)
+        {
+            parser->stats.errors_too_long++;
+            parser->stats.bytes_dropped += parser->msg_len;
+            parser->state = UART_RX_HUNT;
+            parser->flag_pos = 0;
+        }
+    }
+    return data_len;
+}
@@ -0,0 +1,15 @@
+#ifndef UART_RX_PARSER_H
+#define UART_RX_PARSER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "constants.h"
+#include "data_structs.h"
+
+void uart_rx_parser_reset(uartRxParserType *parser);
+void uart_rx_parser_reset_error(uartRxParserType *parser);
+size_t uart_rx_parser_feed(uartRxParserType *parser, const uint8_t *data, size_t data_len, bool *msg_ready);
+
+#endif // UART_RX_PARSER_H
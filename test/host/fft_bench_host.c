@@ -0,0 +1,245 @@
+// Host benchmark of the portable part of the spectrum pipeline
+//
+// Runs the stages of task_fft_calculation that have no ESP-IDF dependencies on a Linux host with the
+// firmware code: prepare (fft_window_pack_raw with the FFT_DEFAULT_WINDOW table, as fft_prepare_complex_arr_raw),
+// re_im (fft_ansi_fc32, the ANSI reference backend, plus fft_real_split_table with FFT_REAL_INPUT),
+// powers (fft_calculate_powers), percentile (fft_percentile_n_components), select (fft_select_top_powers)
+// and pack (index sort + data_codec_encode_spectrum, as FFT PACKED). The signal mean is the bias, like the
+// calibrated offset on the target. The esp-dsp backends only exist on the target (BENCH command, fft_bench.c),
+// and without FFT_REAL_INPUT the esp-dsp dsps_cplx2reC_fc32 step is not measured.
+//
+// Usage: fft_bench_host [iterations] [raw_counts.bin]
+// raw_counts.bin holds little endian int16 counts of one accel channel, e.g. the counts of a RAW_SAMPLES dump.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "constants.h"
+#include "fft_ansi.h"
+#include "fft_prepare.h"
+#include "fft_select.h"
+#include "fft_bench_signal.h"
+#include "data_codec.h"
+
+typedef enum bench_stage_type
+{
+    BENCH_STAGE_PREPARE,
+    BENCH_STAGE_RE_IM,
+    BENCH_STAGE_POWERS,
+    BENCH_STAGE_PERCENTILE,
+    BENCH_STAGE_SELECT,
+    BENCH_STAGE_PACK,
+    BENCH_N_STAGES
+} bench_stage_type;
+
+static const char *bench_stage_names[BENCH_N_STAGES] = {"prepare", "re_im", "powers", "percentile", "select", "pack"};
+
+#if FFT_REAL_INPUT == 1
+#define BENCH_PATH_NAME "real input"
+#define BENCH_PACK_STRIDE 1 // N real samples packed as N/2 complex points
+#else
+#define BENCH_PATH_NAME "complex"
+#define BENCH_PACK_STRIDE 2 // N complex points with zero im parts
+#endif
+
+static int64_t bench_time_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static int bench_compare_index_ascending(const void *a, const void *b)
+{
+    uint32_t ia = ((const indexed_float_type *)a)->index;
+    uint32_t ib = ((const indexed_float_type *)b)->index;
+    return (ia > ib) - (ia < ib);
+}
+
+/**
+ * @brief Run the portable chain on one signal and print per stage time, throughput and memory
+ *
+ * @param name signal name
+ * @param signal_arr raw counts
+ * @param n_samples number of samples (power of 2, <= N_SAMPLES)
+ * @param iterations number of timed runs
+ * @return 0 OK
+ * @return -1 failed to allocate the buffers or to init the FFT
+ */
+static int bench_run(const char *name, const int16_t *signal_arr, uint32_t n_samples, uint32_t iterations)
+{
+    uint32_t n_bins = n_samples / 2;
+    uint32_t n_points = FFT_COMPONENTS_LEN(n_samples) / 2;
+    uint32_t max_components = fft_percentile_n_components(FFT_MS_PERCENTILE, n_bins);
+    size_t buffers_bytes = (N_SAMPLES / 2 + 1) * sizeof(float) +     // half window table
+                           (N_SAMPLES / 4 + 1) * sizeof(float) +     // real input cosine table
+                           FFT_COMPONENTS_LEN(n_samples) * sizeof(float) + // complex array
+                           n_bins * sizeof(float) +                  // powers
+                           n_bins * sizeof(indexed_float_type) +     // ranked magnitudes
+                           max_components * (sizeof(indexed_float_type) + sizeof(uint32_t) + 2 * sizeof(float)) +
+                           DATA_CODEC_SPECTRUM_MAX_SIZE(max_components);
+
+    float *window = malloc((N_SAMPLES / 2 + 1) * sizeof(float));
+    float *cos_table = malloc((N_SAMPLES / 4 + 1) * sizeof(float));
+    float *complex_arr = malloc(FFT_COMPONENTS_LEN(n_samples) * sizeof(float));
+    float *power_arr = malloc(n_bins * sizeof(float));
+    indexed_float_type *magnitudes = malloc(n_bins * sizeof(indexed_float_type));
+    indexed_float_type *packed = malloc(max_components * sizeof(indexed_float_type));
+    uint32_t *packed_indices = malloc(max_components * sizeof(uint32_t));
+    float *packed_re_im = malloc(2 * max_components * sizeof(float));
+    uint8_t *payload = malloc(DATA_CODEC_SPECTRUM_MAX_SIZE(max_components));
+    int error_code = 0;
+
+    if (window == NULL || cos_table == NULL || complex_arr == NULL || power_arr == NULL || magnitudes == NULL || packed == NULL ||
+        packed_indices == NULL || packed_re_im == NULL || payload == NULL || fft_ansi_init(n_points) != 0)
+    {
+        error_code = -1;
+        goto cleanup;
+    }
+
+    // Same tables as fft_init, built for N_SAMPLES and read with a stride for shorter lengths
+    fft_window_table_fill(window, N_SAMPLES, FFT_DEFAULT_WINDOW);
+    fft_real_cos_table_fill(cos_table, N_SAMPLES);
+
+    // The mean stands in for the calibrated bias, so the gravity offset does not win the ranking as bin 0
+    double sum = 0.0;
+    for (uint32_t i = 0; i < n_samples; i++)
+    {
+        sum += signal_arr[i];
+    }
+    const float bias = (float)(sum / n_samples);
+    const float scale = 1.0f / MPU_ACCEL_FS;
+    int64_t stage_ns[BENCH_N_STAGES] = {0};
+    int64_t worst_ns = 0;
+    int payload_len = 0;
+    uint32_t n_components = 0;
+
+    for (uint32_t iteration = 0; iteration < iterations; iteration++)
+    {
+        int64_t run_start = bench_time_ns();
+        int64_t stage_start = run_start;
+
+        fft_window_pack_raw(signal_arr, scale, -bias * scale, window, N_SAMPLES, complex_arr, BENCH_PACK_STRIDE, n_samples);
+        stage_ns[BENCH_STAGE_PREPARE] += bench_time_ns() - stage_start;
+
+        stage_start = bench_time_ns();
+        fft_ansi_fc32(complex_arr, n_points);
+#if FFT_REAL_INPUT == 1
+        fft_real_split_table(complex_arr, n_samples, cos_table, N_SAMPLES);
+#endif
+        stage_ns[BENCH_STAGE_RE_IM] += bench_time_ns() - stage_start;
+
+        stage_start = bench_time_ns();
+        fft_calculate_powers(power_arr, complex_arr, n_bins);
+        stage_ns[BENCH_STAGE_POWERS] += bench_time_ns() - stage_start;
+
+        stage_start = bench_time_ns();
+        n_components = fft_percentile_n_components(FFT_MS_PERCENTILE, n_bins);
+        stage_ns[BENCH_STAGE_PERCENTILE] += bench_time_ns() - stage_start;
+
+        stage_start = bench_time_ns();
+        fft_select_top_powers(magnitudes, power_arr, n_bins, n_components);
+        stage_ns[BENCH_STAGE_SELECT] += bench_time_ns() - stage_start;
+
+        stage_start = bench_time_ns();
+        memcpy(packed, magnitudes, n_components * sizeof(indexed_float_type));
+        qsort(packed, n_components, sizeof(indexed_float_type), bench_compare_index_ascending);
+        for (uint32_t i = 0; i < n_components; i++)
+        {
+            packed_indices[i] = packed[i].index;
+            packed_re_im[2 * i] = complex_arr[2 * packed[i].index];
+            packed_re_im[2 * i + 1] = complex_arr[2 * packed[i].index + 1];
+        }
+        payload_len = data_codec_encode_spectrum(payload, DATA_CODEC_SPECTRUM_MAX_SIZE(max_components), packed_indices, packed_re_im, n_components);
+        stage_ns[BENCH_STAGE_PACK] += bench_time_ns() - stage_start;
+
+        int64_t run_ns = bench_time_ns() - run_start;
+        if (run_ns > worst_ns)
+            worst_ns = run_ns;
+    }
+    if (payload_len < 0)
+    {
+        error_code = -1;
+        goto cleanup;
+    }
+
+    int64_t total_ns = 0;
+    for (int stage = 0; stage < BENCH_N_STAGES; stage++)
+    {
+        total_ns += stage_ns[stage];
+    }
+    double avg_total_us = total_ns / 1000.0 / iterations;
+
+    printf("%s, ansi %s, N=%u, %u runs, strongest bin %u\n", name, BENCH_PATH_NAME, n_samples, iterations, magnitudes[0].index);
+    for (int stage = 0; stage < BENCH_N_STAGES; stage++)
+    {
+        printf("  %-10s %10.1f us (%4.1f %%)\n", bench_stage_names[stage], stage_ns[stage] / 1000.0 / iterations,
+               total_ns ? 100.0 * stage_ns[stage] / total_ns : 0.0);
+    }
+    printf("  total      %10.1f us avg, %.1f us worst, %.1f captures/s\n", avg_total_us, worst_ns / 1000.0,
+           avg_total_us > 0 ? 1e6 / avg_total_us : 0.0);
+    printf("  buffers %zu B, packed payload %d B for %u components\n", buffers_bytes, payload_len, n_components);
+
+cleanup:
+    fft_ansi_deinit();
+    free(window);
+    free(cos_table);
+    free(complex_arr);
+    free(power_arr);
+    free(magnitudes);
+    free(packed);
+    free(packed_indices);
+    free(packed_re_im);
+    free(payload);
+    return error_code;
+}
+
+int main(int argc, char **argv)
+{
+    const uint32_t bench_sizes[] = {N_SAMPLES_16, N_SAMPLES_32};
+    uint32_t iterations = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 10) : 20;
+    int16_t *signal_arr = malloc(N_SAMPLES * sizeof(int16_t));
+    int16_t *recorded_arr = NULL;
+    size_t n_recorded = 0;
+
+    if (iterations == 0 || signal_arr == NULL)
+    {
+        fprintf(stderr, "Usage: %s [iterations] [raw_counts.bin]\n", argv[0]);
+        return 2;
+    }
+    if (argc > 2)
+    {
+        FILE *file = fopen(argv[2], "rb");
+        recorded_arr = malloc(N_SAMPLES * sizeof(int16_t));
+        if (file == NULL || recorded_arr == NULL)
+        {
+            fprintf(stderr, "Failed to read %s\n", argv[2]);
+            return 2;
+        }
+        n_recorded = fread(recorded_arr, sizeof(int16_t), N_SAMPLES, file);
+        fclose(file);
+    }
+
+    for (size_t i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); i++)
+    {
+        if (bench_sizes[i] > N_SAMPLES)
+            continue;
+
+        fft_bench_generate_signal(signal_arr, bench_sizes[i]);
+        if (bench_run("synthetic", signal_arr, bench_sizes[i], iterations) != 0)
+            return 1;
+        if (n_recorded >= bench_sizes[i] && bench_run("recorded", recorded_arr, bench_sizes[i], iterations) != 0)
+            return 1;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("peak resident memory %ld kB\n", usage.ru_maxrss);
+
+    free(signal_arr);
+    free(recorded_arr);
+    return 0;
+}
@@ -0,0 +1,182 @@
+// Host stress test of the capture buffer ownership states (capture_state.c)
+//
+// One thread per firmware role hammers a small pool of buffers with the same claims and transitions
+// the tasks use. SAMPLING and PROCESSING are exclusive: the thread that entered them counts itself
+// as owner, writes its id into the buffer, checks that nobody overwrote it and must be able to leave
+// the state again. Any second owner, overwritten data or lost transition fails the test.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "capture_state.h"
+
+#define TEST_N_BUFFERS 3
+#define TEST_DURATION_MS 1000
+#define TEST_WORK_WORDS 16
+
+typedef struct testBufferType
+{
+    captureStateType state;
+    atomic_int owners;
+    volatile uint32_t data[TEST_WORK_WORDS];
+} testBufferType;
+
+typedef enum test_role_type
+{
+    TEST_ROLE_START,    // FREE / READY / PUBLISHED -> PROCESSING -> QUEUED (cmd_capture_start)
+    TEST_ROLE_SAMPLING, // QUEUED -> SAMPLING -> READY, SAMPLING -> FREE on errors (task_mpu6050_data_sampling)
+    TEST_ROLE_FFT,      // READY / PUBLISHED -> PROCESSING -> PUBLISHED (cmd_capture_send, task_fft_calculation)
+    TEST_ROLE_DUMP,     // READY / PUBLISHED -> PROCESSING -> previous state (cmd_capture_dump, benchmark copy)
+    TEST_N_ROLES
+} test_role_type;
+
+static const char *test_role_names[TEST_N_ROLES] = {"start", "sampling", "fft", "dump"};
+
+static testBufferType test_buffers[TEST_N_BUFFERS];
+static atomic_uint test_errors;
+static atomic_bool test_stop;
+static uint32_t test_owned[TEST_N_ROLES];
+
+/**
+ * @brief Own a buffer that the calling thread just moved to SAMPLING or PROCESSING
+ *
+ * @param buffer buffer
+ * @param owner_id value written to the buffer, unique per thread
+ */
+static void test_own(testBufferType *buffer, uint32_t owner_id)
+{
+    if (atomic_fetch_add(&buffer->owners, 1) != 0)
+        atomic_fetch_add(&test_errors, 1);
+
+    for (int i = 0; i < TEST_WORK_WORDS; i++)
+        buffer->data[i] = owner_id;
+    // Let the other roles try to claim the buffer while it is owned, also on a single core host
+    sched_yield();
+    for (int i = 0; i < TEST_WORK_WORDS; i++)
+    {
+        if (buffer->data[i] != owner_id)
+        {
+            atomic_fetch_add(&test_errors, 1);
+            break;
+        }
+    }
+
+    atomic_fetch_sub(&buffer->owners, 1);
+}
+
+/**
+ * @brief Leave an exclusive state, nobody else may have changed it
+ */
+static void test_release(testBufferType *buffer, capture_state_type from, capture_state_type to)
+{
+    if (!capture_state_transition(&buffer->state, from, to))
+        atomic_fetch_add(&test_errors, 1);
+}
+
+static void *test_role_thread(void *params)
+{
+    test_role_type role = (test_role_type)(intptr_t)params;
+    uint32_t owner_id = role + 1;
+    uint32_t lcg = 0x9E3779B9u * owner_id;
+    capture_state_type previous;
+
+    while (!atomic_load(&test_stop))
+    {
+        lcg = lcg * 1664525u + 1013904223u;
+        testBufferType *buffer = &test_buffers[(lcg >> 16) % TEST_N_BUFFERS];
+
+        switch (role)
+        {
+        case TEST_ROLE_START:
+            if (capture_state_claim(&buffer->state, CAPTURE_STATES_IDLE, CAPTURE_STATE_PROCESSING, NULL))
+            {
+                test_own(buffer, owner_id);
+                test_release(buffer, CAPTURE_STATE_PROCESSING, CAPTURE_STATE_QUEUED);
+                test_owned[role]++;
+            }
+            break;
+
+        case TEST_ROLE_SAMPLING:
+            if (capture_state_transition(&buffer->state, CAPTURE_STATE_QUEUED, CAPTURE_STATE_SAMPLING))
+            {
+                test_own(buffer, owner_id);
+                test_release(buffer, CAPTURE_STATE_SAMPLING, ((lcg >> 8) % 16 == 0) ? CAPTURE_STATE_FREE : CAPTURE_STATE_READY);
+                test_owned[role]++;
+            }
+            break;
+
+        case TEST_ROLE_FFT:
+            if (capture_state_claim(&buffer->state, CAPTURE_STATES_COMPLETE, CAPTURE_STATE_PROCESSING, NULL))
+            {
+                test_own(buffer, owner_id);
+                test_release(buffer, CAPTURE_STATE_PROCESSING, CAPTURE_STATE_PUBLISHED);
+                test_owned[role]++;
+            }
+            break;
+
+        case TEST_ROLE_DUMP:
+            if (capture_state_claim(&buffer->state, CAPTURE_STATES_COMPLETE, CAPTURE_STATE_PROCESSING, &previous))
+            {
+                if (previous != CAPTURE_STATE_READY && previous != CAPTURE_STATE_PUBLISHED)
+                    atomic_fetch_add(&test_errors, 1);
+                test_own(buffer, owner_id);
+                test_release(buffer, CAPTURE_STATE_PROCESSING, previous);
+                test_owned[role]++;
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    pthread_t threads[TEST_N_ROLES];
+
+    for (int b = 0; b < TEST_N_BUFFERS; b++)
+    {
+        capture_state_init(&test_buffers[b].state);
+        atomic_init(&test_buffers[b].owners, 0);
+    }
+
+    for (int role = 0; role < TEST_N_ROLES; role++)
+    {
+        if (pthread_create(&threads[role], NULL, test_role_thread, (void *)(intptr_t)role) != 0)
+        {
+            fprintf(stderr, "Failed to create thread %s\n", test_role_names[role]);
+            return 2;
+        }
+    }
+    struct timespec duration = {.tv_sec = TEST_DURATION_MS / 1000, .tv_nsec = (TEST_DURATION_MS % 1000) * 1000000L};
+    nanosleep(&duration, NULL);
+    atomic_store(&test_stop, true);
+    for (int role = 0; role < TEST_N_ROLES; role++)
+    {
+        pthread_join(threads[role], NULL);
+    }
+
+    bool all_ran = true;
+    for (int role = 0; role < TEST_N_ROLES; role++)
+    {
+        printf("%-8s owned a buffer %u times\n", test_role_names[role], test_owned[role]);
+        all_ran = all_ran && test_owned[role] > 0;
+    }
+    for (int b = 0; b < TEST_N_BUFFERS; b++)
+    {
+        capture_state_type state = capture_state_get(&test_buffers[b].state);
+        if (state == CAPTURE_STATE_SAMPLING || state == CAPTURE_STATE_PROCESSING)
+            atomic_fetch_add(&test_errors, 1);
+    }
+
+    unsigned int errors = atomic_load(&test_errors);
+    printf("%s: %u ownership errors\n", (errors == 0 && all_ran) ? "PASS" : "FAIL", errors);
+    return (errors == 0 && all_ran) ? 0 : 1;
+}